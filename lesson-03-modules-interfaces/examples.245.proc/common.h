@@ -3,4 +3,6 @@
 #define LEN_MSG 160
 
 #define LOG(...) printk( KERN_INFO "! "__VA_ARGS__ )
-#define ERR(...) printk( KERN_ERR "! "__VA_ARGS__ )
\ No newline at end of file
+#define ERR(...) printk( KERN_ERR "! "__VA_ARGS__ )
+#define NAME_SEQ  "mod_seq"
+#define NAME_COPY "mod_copy"
@@ -8,15 +8,16 @@ static char *get_rw_buf( void ) {
 static ssize_t node_read( struct file *file, char *buf,
                           size_t count, loff_t *ppos ) {
    char *buf_msg = get_rw_buf();
+   size_t len = strlen( buf_msg );        // один раз на вызов
    int res;
    LOG( "read: %ld bytes (ppos=%lld)\n", (long)count, *ppos );
-   if( *ppos >= strlen( buf_msg ) ) {     // EOF
+   if( *ppos >= len ) {                   // EOF
       *ppos = 0;
       LOG( "EOF" );
       return 0;
    }
-   if( count > strlen( buf_msg ) - *ppos ) 
-      count = strlen( buf_msg ) - *ppos;  // это копия
+   if( count > len - *ppos ) 
+      count = len - *ppos;                // это копия
    res = copy_to_user( (void*)buf, buf_msg + *ppos, count );
    *ppos += count;
    LOG( "return %ld bytes\n", (long)count );
@@ -1,11 +1,25 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
 #include "common.h"
 
+// mcat [len]                       - читать ноду порциями len и печатать
+// mcat -b [опции]                  - нагрузочный тест ноды proc/sysfs :
+//    -f path   нода (по умолчанию /proc/mod_node или /proc/mod_dir/mod_node)
+//    -r N      потоков чтения (1),   -w N  потоков записи (0)
+//    -c len    порция read()/write() в байтах (LEN_MSG)
+//    -d sec    длительность (5),     -n N  или число операций на поток
+//              (с -n поток сдаётся, если sec секунд подряд получает EAGAIN)
+// Результат: операций/с, MB/с и задержки одного вызова p50/p99/p999.
+
+static char dev[ 80 ];
+
 static int get_proc( void ) {
-   char dev[ 80 ];
    int df;
    sprintf( dev, "/proc/%s", NAME_NODE );
    if( ( df = open( dev, O_RDONLY ) ) < 0 ) {
@@ -16,10 +30,8 @@ static int get_proc( void ) {
    return df;
 }
 
-int main( int argc, char *argv[] ) {
-   int df = get_proc(),
-       len = ( argc > 1 && atoi( argv[ 1 ] ) > 0 ) ?
-             atoi( argv[ 1 ] ) : LEN_MSG; 
+static int cat( int len ) {
+   int df = get_proc();
    char msg[ LEN_MSG + 1 ] = "";
    char *p = msg;
    int res;
@@ -33,4 +45,171 @@ int main( int argc, char *argv[] ) {
    } while ( res > 0 );
    close( df );
    return EXIT_SUCCESS;
+}
+
+// Гистограмма задержек: 16 линейных поддиапазонов на каждую степень двойки,
+// погрешность перцентилей не больше 1/16
+#define SUB_BITS 4
+#define SUB      ( 1 << SUB_BITS )
+#define BUCKETS  ( 64 * SUB )
+
+struct worker {
+   pthread_t tid;
+   int write;
+   long long ops, bytes, retries;
+   long long hist[ BUCKETS ];
+};
+
+static const char *path;
+static int chunk = LEN_MSG;
+static long long iterations;
+static int seconds = 5;
+static volatile int stop;
+
+static long long now_ns( void ) {
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int bucket( long long ns ) {
+   int log = 63 - __builtin_clzll( ns | 1 );
+   if( log < SUB_BITS ) return ns;
+   return ( log - SUB_BITS + 1 ) * SUB + ( ( ns >> ( log - SUB_BITS ) ) & ( SUB - 1 ) );
+}
+
+// верхняя граница значений, попадающих в корзину
+static long long bucket_ns( int b ) {
+   int log = b / SUB + SUB_BITS - 1;
+   if( b < SUB ) return b;
+   return ( ( (long long)( SUB + b % SUB ) + 1 ) << ( log - SUB_BITS ) ) - 1;
+}
+
+static int node_open( int write ) {
+   // O_NONBLOCK: потоковые ноды (procfs_rw) не должны усыплять тест
+   int df = open( path, ( write ? O_WRONLY : O_RDONLY ) | O_NONBLOCK );
+   if( df < 0 )
+      printf( "open %s error: %m\n", path ), exit( EXIT_FAILURE );
+   return df;
+}
+
+static void *worker_run( void *arg ) {
+   struct worker *w = arg;
+   char *buf = malloc( chunk );
+   int df = node_open( w->write );
+   long long t, progress = now_ns();
+   ssize_t res;
+   memset( buf, 'x', chunk );
+   while( !stop && ( !iterations || w->ops < iterations ) ) {
+      t = now_ns();
+      res = w->write ? write( df, buf, chunk ) : read( df, buf, chunk );
+      t = now_ns() - t;
+      if( res < 0 ) {
+         if( EAGAIN == errno || EINTR == errno ) {
+            w->retries++;
+            // повторы не считаются в -n: пустая нода иначе держала бы вечно
+            if( iterations && now_ns() - progress > seconds * 1000000000LL ) {
+               printf( "%s %s: no progress for %d s, stopped after %lld ops\n",
+                       w->write ? "write" : "read", path, seconds, w->ops );
+               break;
+            }
+            continue;
+         }
+         printf( "%s %s error: %m\n", w->write ? "write" : "read", path );
+         exit( EXIT_FAILURE );
+      }
+      progress = now_ns();
+      w->hist[ bucket( t ) ]++;
+      w->ops++;
+      w->bytes += res;
+      // EOF: в начало, а если нода не позиционируется - заново открыть
+      if( 0 == res && !w->write && lseek( df, 0, SEEK_SET ) < 0 ) {
+         close( df );
+         df = node_open( 0 );
+      }
+   }
+   close( df );
+   free( buf );
+   return NULL;
+}
+
+static long long percentile( long long *hist, long long total, double q ) {
+   long long need = total * q, seen = 0;
+   int b;
+   for( b = 0; b < BUCKETS; b++ )
+      if( ( seen += hist[ b ] ) > need )
+         return bucket_ns( b );
+   return 0;
+}
+
+static void report( const char *what, struct worker *w, int n, double sec ) {
+   long long hist[ BUCKETS ] = { 0 }, ops = 0, bytes = 0, retries = 0;
+   int i, b;
+   if( 0 == n ) return;
+   for( i = 0; i < n; i++ ) {
+      ops += w[ i ].ops;
+      bytes += w[ i ].bytes;
+      retries += w[ i ].retries;
+      for( b = 0; b < BUCKETS; b++ )
+         hist[ b ] += w[ i ].hist[ b ];
+   }
+   printf( "%-6s x%-2d %10.0f ops/s %9.2f MB/s  p50 %7lld  p99 %7lld  p999 %7lld ns"
+           "  (EAGAIN %lld)\n", what, n, ops / sec, bytes / sec / 1e6,
+           percentile( hist, ops, 0.5 ), percentile( hist, ops, 0.99 ),
+           percentile( hist, ops, 0.999 ), retries );
+}
+
+static int bench( int readers, int writers ) {
+   struct worker *w = calloc( readers + writers, sizeof( *w ) );
+   long long t0;
+   double sec;
+   int i;
+   if( NULL == w )
+      printf( "out of memory\n" ), exit( EXIT_FAILURE );
+   t0 = now_ns();
+   for( i = 0; i < readers + writers; i++ ) {
+      w[ i ].write = i >= readers;
+      pthread_create( &w[ i ].tid, NULL, worker_run, &w[ i ] );
+   }
+   if( !iterations ) {
+      sleep( seconds );
+      stop = 1;
+   }
+   for( i = 0; i < readers + writers; i++ )
+      pthread_join( w[ i ].tid, NULL );
+   sec = ( now_ns() - t0 ) * 1e-9;
+   printf( "%s: chunk %d bytes, %.2f s\n", path, chunk, sec );
+   report( "read", w, readers, sec );
+   report( "write", w + readers, writers, sec );
+   free( w );
+   return EXIT_SUCCESS;
+}
+
+int main( int argc, char *argv[] ) {
+   int readers = 1, writers = 0, bmode = 0, opt;
+   while( ( opt = getopt( argc, argv, "bf:r:w:c:d:n:" ) ) != -1 ) {
+      switch( opt ) {
+         case 'b': bmode = 1; break;
+         case 'f': path = optarg; break;
+         case 'r': readers = atoi( optarg ); break;
+         case 'w': writers = atoi( optarg ); break;
+         case 'c': chunk = atoi( optarg ); break;
+         case 'd': seconds = atoi( optarg ); break;
+         case 'n': iterations = atoll( optarg ); break;
+         default:
+            printf( "usage: %s [len] | -b [-f path] [-r readers] [-w writers] "
+                    "[-c chunk] [-d sec | -n ops]\n", argv[ 0 ] );
+            return EXIT_FAILURE;
+      }
+   }
+   if( !bmode )
+      return cat( ( optind < argc && atoi( argv[ optind ] ) > 0 ) ?
+                  atoi( argv[ optind ] ) : LEN_MSG );
+   if( chunk <= 0 || readers < 0 || writers < 0 || readers + writers == 0 )
+      printf( "bad arguments\n" ), exit( EXIT_FAILURE );
+   if( NULL == path ) {
+      close( get_proc() );               // та же нода, что и без -b
+      path = dev;
+   }
+   return bench( readers, writers );
 };
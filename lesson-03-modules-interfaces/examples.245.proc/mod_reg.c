@@ -0,0 +1,245 @@
+#include "mod_proc.h"
+#include <linux/seq_file.h>
+#include <linux/hashtable.h>
+#include <linux/stringhash.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/ctype.h>
+
+// Реестр нод /proc/mod_dir/<имя>, создаваемых во время работы :
+//    echo "add foo" > /proc/mod_dir/ctl
+//    echo "del foo" > /proc/mod_dir/ctl
+//    cat /proc/mod_dir/ctl        - список нод и память, занятая каждой
+// У каждой ноды свой буфер, он выделяется при первой записи. Чтение
+// находит ноду через PDE_DATA() и берёт только её собственную блокировку,
+// так что тысячи нод читаются параллельно без общего буфера.
+
+#define NAME_CTL "ctl"
+#define REG_HASH_BITS 10
+
+static uint node_size = LEN_MSG;
+module_param( node_size, uint, S_IRUGO );
+MODULE_PARM_DESC( node_size, "largest message kept by one node" );
+
+struct reg_node {
+   struct hlist_node hash;
+   struct proc_dir_entry *pde;
+   struct rw_semaphore lock;   // защищает buf и len
+   char *buf;
+   size_t len;
+   char name[];
+};
+
+static DEFINE_HASHTABLE( reg_nodes, REG_HASH_BITS );
+static DEFINE_MUTEX( reg_lock ); // добавление, удаление, обход таблицы
+static ulong reg_count;
+static struct proc_dir_entry *own_proc_dir;
+
+static u32 reg_hash( const char *name ) {
+   return full_name_hash( NULL, name, strlen( name ) );
+}
+
+// reg_lock должен быть захвачен
+static struct reg_node *reg_find( const char *name ) {
+   struct reg_node *node;
+   hash_for_each_possible( reg_nodes, node, hash, reg_hash( name ) )
+      if( 0 == strcmp( node->name, name ) )
+         return node;
+   return NULL;
+}
+
+// память ноды: сама структура с именем, буфер и запись procfs
+static size_t reg_cost( struct reg_node *node ) {
+   return ksize( node ) + ( node->buf ? ksize( node->buf ) : 0 ) +
+          ksize( node->pde );
+}
+
+static ssize_t reg_node_read( struct file *file, char __user *buf,
+                              size_t count, loff_t *ppos ) {
+   struct reg_node *node = PDE_DATA( file_inode( file ) );
+   ssize_t ret = 0;
+   down_read( &node->lock );
+   if( *ppos < node->len ) {
+      if( count > node->len - *ppos )
+         count = node->len - *ppos;
+      if( copy_to_user( buf, node->buf + *ppos, count ) )
+         ret = -EFAULT;
+      else {
+         *ppos += count;
+         ret = count;
+      }
+   }
+   up_read( &node->lock );
+   return ret;
+}
+
+static ssize_t reg_node_write( struct file *file, const char __user *buf,
+                               size_t count, loff_t *ppos ) {
+   struct reg_node *node = PDE_DATA( file_inode( file ) );
+   size_t len = min_t( size_t, count, node_size );
+   char *msg, *old;
+   if( 0 == len ) return 0;
+   msg = kmalloc( len, GFP_KERNEL );
+   if( NULL == msg ) return -ENOMEM;
+   if( copy_from_user( msg, buf, len ) ) {
+      kfree( msg );
+      return -EFAULT;
+   }
+   down_write( &node->lock );
+   old = node->buf;
+   node->buf = msg;
+   node->len = len;
+   up_write( &node->lock );
+   kfree( old );
+   return len;
+}
+
+static const struct file_operations reg_node_fops = {
+   .owner  = THIS_MODULE,
+   .read   = reg_node_read,
+   .write  = reg_node_write,
+   .llseek = default_llseek
+};
+
+static bool reg_name_valid( const char *name ) {
+   const char *p;
+   if( 0 == *name || strlen( name ) > NAME_MAX || 0 == strcmp( name, NAME_CTL ) )
+      return false;
+   for( p = name; *p; p++ )
+      if( '/' == *p || !isgraph( *p ) )
+         return false;
+   return true;
+}
+
+static int reg_add( const char *name ) {
+   struct reg_node *node;
+   int ret = 0;
+   if( !reg_name_valid( name ) ) return -EINVAL;
+   node = kzalloc( sizeof( *node ) + strlen( name ) + 1, GFP_KERNEL );
+   if( NULL == node ) return -ENOMEM;
+   strcpy( node->name, name );
+   init_rwsem( &node->lock );
+   mutex_lock( &reg_lock );
+   if( reg_find( name ) ) {
+      ret = -EEXIST;
+      goto out;
+   }
+   node->pde = proc_create_data( name, S_IFREG | S_IRUGO | S_IWUGO, own_proc_dir,
+                                 &reg_node_fops, node );
+   if( NULL == node->pde ) {
+      ret = -ENOMEM;
+      goto out;
+   }
+   hash_add( reg_nodes, &node->hash, reg_hash( name ) );
+   reg_count++;
+out:
+   mutex_unlock( &reg_lock );
+   if( ret ) kfree( node );
+   return ret;
+}
+
+// proc_remove() ждёт завершения текущих read/write, после него ноду
+// больше никто не видит и её можно освободить
+static void reg_free( struct reg_node *node ) {
+   proc_remove( node->pde );
+   kfree( node->buf );
+   kfree( node );
+}
+
+static int reg_del( const char *name ) {
+   struct reg_node *node;
+   mutex_lock( &reg_lock );
+   node = reg_find( name );
+   if( node ) {
+      hash_del( &node->hash );
+      reg_count--;
+   }
+   mutex_unlock( &reg_lock );
+   if( NULL == node ) return -ENOENT;
+   reg_free( node );
+   return 0;
+}
+
+static ssize_t ctl_write( struct file *file, const char __user *buf,
+                          size_t count, loff_t *ppos ) {
+   char cmd[ NAME_MAX + 8 ], *name;
+   int ret;
+   if( count >= sizeof( cmd ) ) return -EINVAL;
+   if( copy_from_user( cmd, buf, count ) ) return -EFAULT;
+   cmd[ count ] = '\0';
+   name = strim( cmd );
+   if( 0 == strncmp( name, "add ", 4 ) )
+      ret = reg_add( skip_spaces( name + 4 ) );
+   else if( 0 == strncmp( name, "del ", 4 ) )
+      ret = reg_del( skip_spaces( name + 4 ) );
+   else
+      ret = -EINVAL;
+   return ret ? ret : count;
+}
+
+static int ctl_show( struct seq_file *m, void *v ) {
+   struct reg_node *node;
+   size_t cost, total = 0;
+   int bkt;
+   mutex_lock( &reg_lock );
+   seq_printf( m, "%-32s %8s %8s\n", "name", "len", "bytes" );
+   hash_for_each( reg_nodes, bkt, node, hash ) {
+      down_read( &node->lock );
+      cost = reg_cost( node );
+      seq_printf( m, "%-32s %8zu %8zu\n", node->name, node->len, cost );
+      up_read( &node->lock );
+      total += cost;
+   }
+   seq_printf( m, "nodes: %lu, bytes: %zu, per node: %zu\n", reg_count, total,
+               reg_count ? total / reg_count : 0 );
+   mutex_unlock( &reg_lock );
+   return 0;
+}
+
+static int ctl_open( struct inode *inode, struct file *file ) {
+   return single_open( file, ctl_show, NULL );
+}
+
+static const struct file_operations ctl_fops = {
+   .owner   = THIS_MODULE,
+   .open    = ctl_open,
+   .read    = seq_read,
+   .write   = ctl_write,
+   .llseek  = seq_lseek,
+   .release = single_release
+};
+
+static int __init proc_init( void ) {
+   int ret;
+   own_proc_dir = proc_mkdir( NAME_DIR, NULL );
+   if( NULL == own_proc_dir ) {
+      ret = -ENOENT;
+      ERR( "can't create directory /proc/%s\n", NAME_DIR );
+      goto err_dir;
+   }
+   if( NULL == proc_create( NAME_CTL, S_IFREG | S_IRUGO | S_IWUSR, own_proc_dir, &ctl_fops ) ) {
+      ret = -ENOENT;
+      ERR( "can't create node /proc/%s/%s\n", NAME_DIR, NAME_CTL );
+      goto err_ctl;
+   }
+   LOG( "/proc/%s/%s installed\n", NAME_DIR, NAME_CTL );
+   return 0;
+err_ctl:
+   remove_proc_entry( NAME_DIR, NULL );
+err_dir:
+   return ret;
+}
+
+static void __exit proc_exit( void ) {
+   struct reg_node *node;
+   struct hlist_node *tmp;
+   int bkt;
+   remove_proc_entry( NAME_CTL, own_proc_dir );
+   hash_for_each_safe( reg_nodes, bkt, tmp, node, hash ) {
+      hash_del( &node->hash );
+      reg_free( node );
+   }
+   remove_proc_entry( NAME_DIR, NULL );
+   LOG( "/proc/%s removed, %lu nodes\n", NAME_DIR, reg_count );
+}
@@ -0,0 +1,136 @@
+#include "mod_proc.h"
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
+#include <linux/hash.h>
+
+// Большая таблица в /proc/mod_dir :
+//   mod_seq  - seq_file: вывод строится постранично, память O(1)
+//   mod_copy - как fops_rw.c: весь текст строится в одном буфере при open()
+// Обе ноды выдают одинаковый текст, их можно сравнить утилитой seqbench.
+
+static ulong records = 10000;
+module_param( records, ulong, S_IRUGO );
+
+// одна запись "набора данных" - вычисляется по индексу, нигде не хранится
+#define REC_LEN 48
+#define REC_FMT "%8lu %016lx %20lu\n"
+#define REC_ARGS( i ) (i), hash_long( (i), BITS_PER_LONG ), (i) * (i)
+
+static struct proc_dir_entry *own_proc_dir;
+
+static void *seq_node_start( struct seq_file *m, loff_t *pos ) {
+   return *pos < records ? pos : NULL;
+}
+
+static void *seq_node_next( struct seq_file *m, void *v, loff_t *pos ) {
+   ++*pos;
+   return *pos < records ? pos : NULL;
+}
+
+static void seq_node_stop( struct seq_file *m, void *v ) {
+}
+
+static int seq_node_show( struct seq_file *m, void *v ) {
+   ulong i = *(loff_t*)v;
+   seq_printf( m, REC_FMT, REC_ARGS( i ) );
+   return 0;
+}
+
+static const struct seq_operations seq_node_ops = {
+   .start = seq_node_start,
+   .next  = seq_node_next,
+   .stop  = seq_node_stop,
+   .show  = seq_node_show
+};
+
+static int seq_node_open( struct inode *inode, struct file *file ) {
+   return seq_open( file, &seq_node_ops );
+}
+
+static const struct file_operations seq_fops = {
+   .owner   = THIS_MODULE,
+   .open    = seq_node_open,
+   .read    = seq_read,
+   .llseek  = seq_lseek,
+   .release = seq_release
+};
+
+// копирующий вариант: вся таблица в памяти на каждый open()
+struct copy_buf {
+   size_t len;
+   char data[];
+};
+
+static int copy_node_open( struct inode *inode, struct file *file ) {
+   size_t size = records * REC_LEN + 1;
+   struct copy_buf *cb = vmalloc( sizeof( *cb ) + size );
+   ulong i;
+   if( NULL == cb ) return -ENOMEM;
+   cb->len = 0;
+   for( i = 0; i < records; i++ )
+      cb->len += scnprintf( cb->data + cb->len, size - cb->len,
+                            REC_FMT, REC_ARGS( i ) );
+   file->private_data = cb;
+   return 0;
+}
+
+static ssize_t copy_node_read( struct file *file, char __user *buf,
+                               size_t count, loff_t *ppos ) {
+   struct copy_buf *cb = file->private_data;
+   if( *ppos >= cb->len ) return 0;
+   if( count > cb->len - *ppos )
+      count = cb->len - *ppos;
+   if( copy_to_user( buf, cb->data + *ppos, count ) )
+      return -EFAULT;
+   *ppos += count;
+   return count;
+}
+
+static int copy_node_release( struct inode *inode, struct file *file ) {
+   vfree( file->private_data );
+   return 0;
+}
+
+static const struct file_operations copy_fops = {
+   .owner   = THIS_MODULE,
+   .open    = copy_node_open,
+   .read    = copy_node_read,
+   .llseek  = default_llseek,
+   .release = copy_node_release
+};
+
+static int __init proc_init( void ) {
+   int ret;
+   own_proc_dir = proc_mkdir( NAME_DIR, NULL );
+   if( NULL == own_proc_dir ) {
+      ret = -ENOENT;
+      ERR( "can't create directory /proc/%s\n", NAME_DIR );
+      goto err_dir;
+   }
+   if( NULL == proc_create( NAME_SEQ, S_IFREG | S_IRUGO, own_proc_dir, &seq_fops ) ) {
+      ret = -ENOENT;
+      ERR( "can't create node /proc/%s/%s\n", NAME_DIR, NAME_SEQ );
+      goto err_seq;
+   }
+   if( NULL == proc_create( NAME_COPY, S_IFREG | S_IRUGO, own_proc_dir, &copy_fops ) ) {
+      ret = -ENOENT;
+      ERR( "can't create node /proc/%s/%s\n", NAME_DIR, NAME_COPY );
+      goto err_copy;
+   }
+   LOG( "/proc/%s/{%s,%s} installed, %lu records\n",
+        NAME_DIR, NAME_SEQ, NAME_COPY, records );
+   return 0;
+err_copy:
+   remove_proc_entry( NAME_SEQ, own_proc_dir );
+err_seq:
+   remove_proc_entry( NAME_DIR, NULL );
+err_dir:
+   return ret;
+}
+
+static void __exit proc_exit( void ) {
+   remove_proc_entry( NAME_COPY, own_proc_dir );
+   remove_proc_entry( NAME_SEQ, own_proc_dir );
+   remove_proc_entry( NAME_DIR, NULL );
+   LOG( "/proc/%s/{%s,%s} removed\n", NAME_DIR, NAME_SEQ, NAME_COPY );
+}
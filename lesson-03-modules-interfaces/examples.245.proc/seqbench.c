@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "common.h"
+
+// Сравнение seq_file и копирующего чтения большой таблицы (mod_seq.ko):
+//    ./seqbench [chunk] [passes]
+// каждый проход: open(), read() до EOF порциями chunk, close()
+
+static double now( void ) {
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench( const char *node, char *buf, int chunk, int passes ) {
+   char path[ 80 ];
+   long long total = 0;
+   double t0, first = 0, t;
+   int i, df, res;
+   sprintf( path, "/proc/%s/%s", NAME_DIR, node );
+   t0 = now();
+   for( i = 0; i < passes; i++ ) {
+      if( ( df = open( path, O_RDONLY ) ) < 0 )
+         printf( "open %s error: %m\n", path ), exit( EXIT_FAILURE );
+      while( ( res = read( df, buf, chunk ) ) > 0 ) {
+         total += res;
+         if( 0 == first ) first = now() - t0;   // задержка до первых данных
+      }
+      if( res < 0 )
+         printf( "read %s error: %m\n", path ), exit( EXIT_FAILURE );
+      close( df );
+   }
+   t = now() - t0;
+   printf( "%-9s chunk %7d: %8.3f ms/pass %9.1f MB/s, first data after %7.1f us\n",
+           node, chunk, t * 1e3 / passes, total / t / 1e6, first * 1e6 );
+}
+
+int main( int argc, char *argv[] ) {
+   int chunk = ( argc > 1 && atoi( argv[ 1 ] ) > 0 ) ? atoi( argv[ 1 ] ) : 0,
+       passes = ( argc > 2 && atoi( argv[ 2 ] ) > 0 ) ? atoi( argv[ 2 ] ) : 20;
+   int sizes[] = { 128, 1024, 4096, 65536, 1 << 20 },
+       n = sizeof( sizes ) / sizeof( sizes[ 0 ] ), i;
+   char *buf = malloc( 1 << 20 );
+   if( chunk ) {                          // только заданная порция
+      sizes[ 0 ] = chunk < ( 1 << 20 ) ? chunk : 1 << 20;
+      n = 1;
+   }
+   for( i = 0; i < n; i++ ) {
+      bench( NAME_SEQ, buf, sizes[ i ], passes );
+      bench( NAME_COPY, buf, sizes[ i ], passes );
+   }
+   free( buf );
+   return EXIT_SUCCESS;
+};
@@ -0,0 +1,207 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/compat.h>
+#include <linux/miscdevice.h>
+#include <linux/uaccess.h>
+#include <linux/sched.h>
+#include <linux/sched/signal.h>
+
+#include "batch.h"
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Batched syscalls in one kernel entry");
+MODULE_VERSION("0.1");
+
+
+#define MODULE_TAG	"batch "
+
+/*
+ * Ops are copied in and their results out BATCH_CHUNK at a time, so a
+ * batch of any length needs only a small buffer on the stack.
+ */
+#define BATCH_CHUNK	8
+
+
+/*
+ * The same steps as the read()/write() syscalls after the entry. Without
+ * the f_pos lock of fdget_pos(), which is not exported, threads sharing a
+ * file may see the position updated by only one of two concurrent ops.
+ */
+static long batch_rw(struct batch_op *op)
+{
+	void __user *buf = u64_to_user_ptr(op->buf);
+	bool positioned = op->op == BATCH_OP_PREAD ||
+					  op->op == BATCH_OP_PWRITE;
+	bool write = op->op == BATCH_OP_WRITE || op->op == BATCH_OP_PWRITE;
+	struct fd f;
+	loff_t pos;
+	long ret;
+
+	if (positioned && op->off < 0)
+		return -EINVAL;
+	/* a 32-bit kernel would truncate the length */
+	if (op->len > SIZE_MAX)
+		return -EINVAL;
+
+	f = fdget(op->fd);
+	if (!f.file)
+		return -EBADF;
+
+	/* as pread64()/pwrite64(), pipes and sockets have no position */
+	if (positioned &&
+		!(f.file->f_mode & (write ? FMODE_PWRITE : FMODE_PREAD))) {
+		fdput(f);
+		return -ESPIPE;
+	}
+
+	pos = positioned ? op->off : f.file->f_pos;
+	if (write)
+		ret = vfs_write(f.file, buf, op->len, &pos);
+	else
+		ret = vfs_read(f.file, buf, op->len, &pos);
+	if (!positioned && ret >= 0)
+		f.file->f_pos = pos;
+
+	fdput(f);
+
+	/*
+	 * An interrupted op can't be restarted on its own once the ioctl
+	 * returns a count, so userspace gets what read()/write() would give
+	 * it without SA_RESTART.
+	 */
+	if (ret == -ERESTARTSYS || ret == -ERESTARTNOINTR ||
+		ret == -ERESTARTNOHAND || ret == -ERESTART_RESTARTBLOCK)
+		ret = -EINTR;
+	return ret;
+}
+
+
+static long batch_exec(struct batch_op *op)
+{
+	switch (op->op) {
+	case BATCH_OP_NOP:
+		return 0;
+	case BATCH_OP_GETPID:
+		return task_tgid_vnr(current);
+	case BATCH_OP_READ:
+	case BATCH_OP_WRITE:
+	case BATCH_OP_PREAD:
+	case BATCH_OP_PWRITE:
+		return batch_rw(op);
+	default:
+		return -EINVAL;
+	}
+}
+
+
+static long batch_submit(struct batch_req __user *ureq)
+{
+	struct batch_op ops[BATCH_CHUNK];
+	struct batch_op __user *uops;
+	struct batch_req req;
+	unsigned int done = 0, n, i;
+	bool stop = false;
+
+	if (copy_from_user(&req, ureq, sizeof(req)))
+		return -EFAULT;
+	if (req.flags & ~BATCH_STOP_ON_ERROR)
+		return -EINVAL;
+	if (req.count > INT_MAX)
+		return -E2BIG;
+	uops = u64_to_user_ptr(req.ops);
+
+	while (done < req.count && !stop) {
+		n = min_t(unsigned int, req.count - done, BATCH_CHUNK);
+		if (copy_from_user(ops, uops + done, n * sizeof(ops[0])))
+			return done ? done : -EFAULT;
+
+		for (i = 0; i < n; i++) {
+			if (signal_pending(current)) {
+				stop = true;
+				break;
+			}
+			ops[i].result = batch_exec(&ops[i]);
+			if (ops[i].result < 0 && (req.flags & BATCH_STOP_ON_ERROR)) {
+				i++;
+				stop = true;
+				break;
+			}
+		}
+
+		/* the earlier chunks' results are already out */
+		if (copy_to_user(uops + done, ops, i * sizeof(ops[0])))
+			return done ? done : -EFAULT;
+		done += i;
+		cond_resched();
+	}
+
+	if (done == 0 && req.count && signal_pending(current))
+		return -ERESTARTSYS;
+	return done;
+}
+
+
+static long batch_ioctl(struct file *file_p, unsigned int cmd,
+						unsigned long arg)
+{
+	switch (cmd) {
+	case BATCH_IOC_SUBMIT:
+		return batch_submit((struct batch_req __user *)arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+
+#ifdef CONFIG_COMPAT
+/* batch.h has fixed-width fields only, just the pointer needs converting */
+static long batch_compat_ioctl(struct file *file_p, unsigned int cmd,
+							   unsigned long arg)
+{
+	return batch_ioctl(file_p, cmd, (unsigned long)compat_ptr(arg));
+}
+#endif
+
+
+static const struct file_operations batch_fops = {
+	.owner          = THIS_MODULE,
+	.unlocked_ioctl = batch_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl   = batch_compat_ioctl,
+#endif
+	.llseek         = no_llseek,
+};
+
+static struct miscdevice batch_miscdev = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name  = "batch",
+	.fops  = &batch_fops,
+	.mode  = 0666,
+};
+
+
+static int __init batch_init(void)
+{
+	int err = misc_register(&batch_miscdev);
+
+	if (err) {
+		pr_err(MODULE_TAG "failed to register /dev/%s: %d\n",
+			   batch_miscdev.name, err);
+		return err;
+	}
+	pr_notice(MODULE_TAG "loaded\n");
+	return 0;
+}
+
+
+static void __exit batch_exit(void)
+{
+	misc_deregister(&batch_miscdev);
+	pr_notice(MODULE_TAG "exited\n");
+}
+
+
+module_init(batch_init);
+module_exit(batch_exit);
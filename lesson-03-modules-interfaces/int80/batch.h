@@ -0,0 +1,55 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * /dev/batch runs an array of syscall-like operations on the caller's
+ * file descriptors in one kernel entry:
+ *
+ *   struct batch_op ops[n] = { ... };
+ *   struct batch_req req = { .ops = (uintptr_t)ops, .count = n };
+ *   done = ioctl(fd, BATCH_IOC_SUBMIT, &req);
+ *
+ * Every executed op gets its return value or -errno in result. The ioctl
+ * returns the number of ops executed, fewer than count when the batch
+ * stopped on an error (BATCH_STOP_ON_ERROR) or on a pending signal. A
+ * fault on the ops array also ends the batch, the ioctl then returns the
+ * ops whose results were written back, or -EFAULT if there are none.
+ * An op interrupted by a signal gets -EINTR, it is not restarted.
+ *
+ * All fields are fixed-width, 32-bit callers on a 64-bit kernel use the
+ * same layout.
+ */
+
+enum batch_opcode {
+	BATCH_OP_NOP,
+	BATCH_OP_GETPID,
+	BATCH_OP_READ,		/* read(fd, buf, len) */
+	BATCH_OP_WRITE,		/* write(fd, buf, len) */
+	BATCH_OP_PREAD,		/* pread(fd, buf, len, off) */
+	BATCH_OP_PWRITE,	/* pwrite(fd, buf, len, off) */
+};
+
+struct batch_op {
+	__u32 op;
+	__s32 fd;
+	__u64 buf;		/* user pointer */
+	__u64 len;
+	__s64 off;
+	__s64 result;
+};
+
+#define BATCH_STOP_ON_ERROR	0x1
+
+struct batch_req {
+	__u64 ops;		/* user pointer to count struct batch_op */
+	__u32 count;
+	__u32 flags;
+};
+
+#define BATCH_IOC_MAGIC		'b'
+#define BATCH_IOC_SUBMIT	_IOW(BATCH_IOC_MAGIC, 1, struct batch_req)
+
+#endif /* _BATCH_H */
@@ -0,0 +1,189 @@
+/*
+ * Tiny syscalls one by one, as mpsys.c issues them, versus the same
+ * sequence submitted to /dev/batch in batches of different sizes.
+ *
+ * The sequence repeats getpid(), write() of a small buffer to /dev/null
+ * and read() of it from /dev/zero. Both loops store every result, the
+ * one-by-one loop from the return values and the batched one from the
+ * ops, and they are checked after the clock stops against the pid read
+ * once at the start.
+ *
+ * usage: batchbench [ops] [bytes per read/write]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include "batch.h"
+
+#define BATCH_PATH	"/dev/batch"
+
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static int open_or_die(const char *path, int flags)
+{
+	int fd = open(path, flags);
+
+	if (fd < 0) {
+		fprintf(stderr, "%s: %m\n", path);
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+
+/* Op i of the sequence */
+static void make_op(struct batch_op *op, long i, int null_fd, int zero_fd,
+		    char *buf, size_t bytes)
+{
+	memset(op, 0, sizeof(*op));
+	switch (i % 3) {
+	case 0:
+		op->op = BATCH_OP_GETPID;
+		break;
+	case 1:
+		op->op = BATCH_OP_WRITE;
+		op->fd = null_fd;
+		op->buf = (uintptr_t)buf;
+		op->len = bytes;
+		break;
+	case 2:
+		op->op = BATCH_OP_READ;
+		op->fd = zero_fd;
+		op->buf = (uintptr_t)buf;
+		op->len = bytes;
+		break;
+	}
+}
+
+
+static void check(const char *what, const long *res, long ops, pid_t pid,
+		  size_t bytes)
+{
+	long i;
+
+	for (i = 0; i < ops; i++) {
+		if (res[i] != (i % 3 == 0 ? pid : (long)bytes)) {
+			fprintf(stderr, "%s: op %ld returned %ld\n", what, i, res[i]);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+
+static double run_single(long ops, int null_fd, int zero_fd, char *buf,
+			 size_t bytes, long *res)
+{
+	double t = now();
+	long i;
+
+	for (i = 0; i < ops; i++) {
+		switch (i % 3) {
+		case 0:
+			res[i] = syscall(__NR_getpid);
+			break;
+		case 1:
+			res[i] = syscall(__NR_write, null_fd, buf, bytes);
+			break;
+		default:
+			res[i] = syscall(__NR_read, zero_fd, buf, bytes);
+			break;
+		}
+	}
+	return now() - t;
+}
+
+
+/*
+ * The ops array is built once, the same way a caller would reuse its
+ * submission buffer, so only submission and execution are timed.
+ */
+static double run_batched(int fd, long ops, int batch, int null_fd,
+			  int zero_fd, char *buf, size_t bytes, long *res)
+{
+	struct batch_op *op = calloc(batch, sizeof(*op));
+	struct batch_req req = { .ops = (uintptr_t)op };
+	long i, j, n;
+	double t;
+
+	for (j = 0; j < batch; j++)
+		make_op(&op[j], j, null_fd, zero_fd, buf, bytes);
+
+	t = now();
+	for (i = 0; i < ops; i += req.count) {
+		req.count = ops - i < batch ? ops - i : batch;
+		n = ioctl(fd, BATCH_IOC_SUBMIT, &req);
+		if (n != req.count) {
+			fprintf(stderr, "submit returned %ld: %m\n", n);
+			exit(EXIT_FAILURE);
+		}
+		for (j = 0; j < n; j++)
+			res[i + j] = op[j].result;
+	}
+	t = now() - t;
+
+	free(op);
+	return t;
+}
+
+
+int main(int argc, char *argv[])
+{
+	/* multiples of the sequence length, each batch starts with getpid */
+	int batches[] = { 3, 12, 48, 192, 768 };
+	long ops = argc > 1 ? atol(argv[1]) : 3000000;
+	size_t bytes = argc > 2 ? atoi(argv[2]) : 64;
+	int fd, null_fd, zero_fd;
+	double single, t;
+	char name[32];
+	long *res;
+	char *buf;
+	pid_t pid;
+	size_t i;
+
+	fd = open_or_die(BATCH_PATH, O_RDWR);
+	null_fd = open_or_die("/dev/null", O_WRONLY);
+	zero_fd = open_or_die("/dev/zero", O_RDONLY);
+	buf = calloc(1, bytes ? bytes : 1);
+	res = malloc((ops ? ops : 1) * sizeof(*res));
+	if (!buf || !res) {
+		perror("malloc");
+		return EXIT_FAILURE;
+	}
+	pid = getpid();
+
+	printf("%ld ops of getpid/write/read, %zu bytes\n", ops, bytes);
+	single = run_single(ops, null_fd, zero_fd, buf, bytes, res);
+	check("syscall()", res, ops, pid, bytes);
+	printf("%-12s %8.1f ns/op\n", "syscall()", single * 1e9 / ops);
+
+	for (i = 0; i < sizeof(batches) / sizeof(batches[0]); i++) {
+		t = run_batched(fd, ops, batches[i], null_fd, zero_fd, buf, bytes,
+				res);
+		snprintf(name, sizeof(name), "batch %d", batches[i]);
+		check(name, res, ops, pid, bytes);
+		printf("batch %-6d %8.1f ns/op  x%.2f\n", batches[i],
+		       t * 1e9 / ops, single / t);
+	}
+
+	free(res);
+	free(buf);
+	close(zero_fd);
+	close(null_fd);
+	close(fd);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,266 @@
+/*
+ * Cost of entering the kernel: the same cheap syscall through int $0x80,
+ * the native syscall instruction, syscall(2) and the libc wrapper, and
+ * clock_gettime() through the kernel and through the vDSO.
+ *
+ * Calls are timed in batches with CLOCK_MONOTONIC, one sample is the mean
+ * of a batch. The empty loop cost is subtracted. Percentiles are over
+ * samples, so they hide single slow calls but show interference.
+ *
+ * A 64-bit kernel built without IA32 emulation, or booted with
+ * ia32_emulation=0, answers int $0x80 with SIGSEGV. Such methods are
+ * tried once in a child and skipped if it dies.
+ *
+ * usage: sysbench [iterations] [batch] [cpu]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#define VULN_DIR	"/sys/devices/system/cpu/vulnerabilities"
+
+/* getpid in the i386 table, which int $0x80 uses even from 64-bit code */
+#define NR32_getpid	20
+
+
+static long nop_call(void)
+{
+	return 0;
+}
+
+
+#if defined(__i386__) || defined(__x86_64__)
+static long int80_getpid(void)
+{
+	long res;
+
+	__asm__ volatile ("int $0x80" :
+		"=a" (res) :
+		"0" (NR32_getpid) :
+#ifdef __x86_64__
+		"r8", "r9", "r10", "r11",
+#endif
+		"memory");
+	return res;
+}
+#endif
+
+
+#ifdef __x86_64__
+static long native_getpid(void)
+{
+	long res;
+
+	__asm__ volatile ("syscall" :
+		"=a" (res) :
+		"0" (__NR_getpid) :
+		"rcx", "r11", "memory");
+	return res;
+}
+#endif
+
+
+static long syscall_getpid(void)
+{
+	return syscall(__NR_getpid);
+}
+
+
+static long libc_getpid(void)
+{
+	return getpid();
+}
+
+
+static long syscall_clock_gettime(void)
+{
+	struct timespec ts;
+
+	return syscall(__NR_clock_gettime, CLOCK_MONOTONIC, &ts);
+}
+
+
+static long vdso_clock_gettime(void)
+{
+	struct timespec ts;
+
+	return clock_gettime(CLOCK_MONOTONIC, &ts);
+}
+
+
+static const struct {
+	const char *name;
+	long (*call)(void);
+	int probe;		/* may fault, try it in a child first */
+} methods[] = {
+#if defined(__i386__) || defined(__x86_64__)
+	{ "int80 getpid",           int80_getpid, 1 },
+#endif
+#ifdef __x86_64__
+	{ "syscall insn getpid",    native_getpid },
+#endif
+	{ "syscall() getpid",       syscall_getpid },
+	{ "libc getpid",            libc_getpid },
+	{ "syscall() clock_gettime", syscall_clock_gettime },
+	{ "vdso clock_gettime",     vdso_clock_gettime },
+};
+
+
+/* 0 if the call kills the process, with the signal in *sig */
+static int usable(long (*call)(void), int *sig)
+{
+	pid_t pid;
+	int status;
+
+	*sig = 0;
+	pid = fork();
+	if (pid < 0)
+		return 0;
+	if (pid == 0) {
+		call();
+		_exit(EXIT_SUCCESS);
+	}
+	if (waitpid(pid, &status, 0) < 0)
+		return 0;
+	if (WIFSIGNALED(status))
+		*sig = WTERMSIG(status);
+	return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+
+static inline unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+
+/* ns per call for each batch, sorted */
+static void run(long (*call)(void), double *sample, long samples, int batch)
+{
+	long (*volatile fn)(void) = call;	/* keep the calls in the loop */
+	unsigned long long t;
+	long s;
+	int i;
+
+	for (i = 0; i < batch; i++)	/* warm up */
+		fn();
+	for (s = 0; s < samples; s++) {
+		t = now_ns();
+		for (i = 0; i < batch; i++)
+			fn();
+		sample[s] = (double)(now_ns() - t) / batch;
+	}
+	qsort(sample, samples, sizeof(*sample), cmp_double);
+}
+
+
+static double pct(const double *sample, long samples, double p)
+{
+	return sample[(long)(p * (samples - 1))];
+}
+
+
+static void print_vulnerabilities(void)
+{
+	char path[512], line[256];
+	struct dirent *de;
+	FILE *f;
+	DIR *d;
+
+	d = opendir(VULN_DIR);
+	if (!d)
+		return;
+	while ((de = readdir(d)) != NULL) {
+		if (de->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", VULN_DIR, de->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		if (fgets(line, sizeof(line), f))
+			printf("# %-24s %s", de->d_name, line);
+		fclose(f);
+	}
+	closedir(d);
+}
+
+
+int main(int argc, char *argv[])
+{
+	long iterations = argc > 1 ? atol(argv[1]) : 10000000;
+	int batch = argc > 2 ? atoi(argv[2]) : 100;
+	long samples;
+	double *sample, empty;
+	cpu_set_t cpus;
+	size_t m;
+
+	if (batch < 1 || iterations < batch) {
+		fprintf(stderr, "usage: %s [iterations] [batch] [cpu]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (argc > 3) {
+		CPU_ZERO(&cpus);
+		CPU_SET(atoi(argv[3]), &cpus);
+		if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0) {
+			perror("sched_setaffinity");
+			return EXIT_FAILURE;
+		}
+	}
+
+	samples = iterations / batch;
+	sample = malloc(samples * sizeof(*sample));
+	if (!sample) {
+		perror("malloc");
+		return EXIT_FAILURE;
+	}
+
+	print_vulnerabilities();
+	run(nop_call, sample, samples, batch);
+	empty = pct(sample, samples, 0.5);
+	printf("# %ld calls per method in batches of %d, loop %.1f ns/call "
+	       "subtracted\n", samples * batch, batch, empty);
+	printf("%-24s %8s %8s %8s %8s %8s\n",
+	       "method", "mean", "p50", "p90", "p99", "p99.9");
+
+	for (m = 0; m < sizeof(methods) / sizeof(methods[0]); m++) {
+		double sum = 0;
+		long s;
+		int sig;
+
+		if (methods[m].probe && !usable(methods[m].call, &sig)) {
+			printf("%-24s skipped, %s\n", methods[m].name,
+			       sig ? strsignal(sig) : "probe failed");
+			continue;
+		}
+		run(methods[m].call, sample, samples, batch);
+		for (s = 0; s < samples; s++)
+			sum += sample[s];
+		printf("%-24s %8.1f %8.1f %8.1f %8.1f %8.1f\n", methods[m].name,
+		       sum / samples - empty,
+		       pct(sample, samples, 0.5) - empty,
+		       pct(sample, samples, 0.9) - empty,
+		       pct(sample, samples, 0.99) - empty,
+		       pct(sample, samples, 0.999) - empty);
+	}
+
+	free(sample);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,43 @@
+#ifndef _EXAMPLE_MMAP_H
+#define _EXAMPLE_MMAP_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * mmap() layout of /proc/example/buffer:
+ *   page 0     - struct example_ring_ctl, updated by the kernel only
+ *   page 1 ... - ring data, stream position pos lives at pos % size
+ *
+ * Readers take a consistent snapshot of head/tail like a seqcount: retry
+ * while seq is odd or changed during the read. A mapped file does not
+ * hold writers back, data behind tail may be overwritten at any time.
+ *
+ * The module must be loaded with mappable=1, the ring pages are then
+ * allocated once at load time.
+ *
+ * Writers place data at head (wrapping at size), bounded by the space
+ * returned by EXAMPLE_IOC_SPACE, and make it visible with
+ * EXAMPLE_IOC_COMMIT. The commit names the head the data was placed at
+ * and fails with EAGAIN if head moved meanwhile, because a write() or
+ * another mapped writer got in first; the bytes must then be placed again
+ * at the new head.
+ */
+struct example_ring_ctl {
+	__u32 seq;
+	__u32 reserved;
+	__u64 head;
+	__u64 tail;
+	__u64 size;
+};
+
+struct example_ring_commit {
+	__u64 head;		/* head seen when the data was placed */
+	__u64 length;
+};
+
+#define EXAMPLE_IOC_MAGIC	'e'
+#define EXAMPLE_IOC_SPACE	_IO(EXAMPLE_IOC_MAGIC, 1)
+#define EXAMPLE_IOC_COMMIT	_IOW(EXAMPLE_IOC_MAGIC, 2, struct example_ring_commit)
+
+#endif /* _EXAMPLE_MMAP_H */
@@ -0,0 +1,190 @@
+/*
+ * /proc/example/buffer through mmap() compared with read()/write().
+ *
+ * write:  write() of a block  vs  memcpy() into the mapping + COMMIT ioctl
+ * read:   read() of a block   vs  summing the latest block in place, with
+ *                                 the ctl page seq/head/tail snapshot
+ *
+ * The module has to be loaded with mappable=1.
+ *
+ * usage: mmapbench [block KB] [MB per test]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "example_mmap.h"
+
+#define PROC_NODE	"/proc/example/buffer"
+
+static volatile struct example_ring_ctl *ctl;
+static unsigned char *data;
+static size_t ring_size;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void snapshot(__u64 *head, __u64 *tail)
+{
+	__u32 seq;
+
+	do {
+		seq = __atomic_load_n(&ctl->seq, __ATOMIC_ACQUIRE);
+		*head = ctl->head;
+		*tail = ctl->tail;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) || seq != ctl->seq);
+}
+
+/* The only writer here, so the commit never finds head moved */
+static int map_write(int fd, const char *buf, size_t len)
+{
+	struct example_ring_commit commit = { .length = len };
+	__u64 tail;
+	size_t off, first;
+
+	if (ioctl(fd, EXAMPLE_IOC_SPACE) < (long)len)
+		return -1;
+
+	snapshot(&commit.head, &tail);
+	off = commit.head % ring_size;
+	first = len < ring_size - off ? len : ring_size - off;
+	memcpy(data + off, buf, first);
+	memcpy(data, buf + first, len - first);
+
+	return ioctl(fd, EXAMPLE_IOC_COMMIT, &commit);
+}
+
+/* Sum of the last len bytes, -1 if they were overwritten meanwhile */
+static long map_read(size_t len)
+{
+	__u64 head, tail, h2, t2, pos;
+	long sum = 0;
+
+	snapshot(&head, &tail);
+	if (head - tail < len)
+		return -1;
+	for (pos = head - len; pos < head; pos++)
+		sum += data[pos % ring_size];
+	snapshot(&h2, &t2);
+
+	return t2 > head - len ? -1 : sum;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t block = (argc > 1 ? atol(argv[1]) : 64) << 10;
+	size_t total = (argc > 2 ? atol(argv[2]) : 256) << 20;
+	size_t moved;
+	double t, t_write = 0, t_map_write = 0, t_read = 0, t_map_read = 0;
+	char *buf;
+	void *map;
+	long page = sysconf(_SC_PAGESIZE);
+	int mfd, wfd, rfd;
+
+	mfd = open(PROC_NODE, O_RDWR);
+	wfd = open(PROC_NODE, O_WRONLY);
+	if (mfd < 0 || wfd < 0) {
+		printf("open %s error: %m\n", PROC_NODE);
+		return EXIT_FAILURE;
+	}
+
+	/* Map the ctl page first to learn the ring size */
+	map = mmap(NULL, page, PROT_READ, MAP_SHARED, mfd, 0);
+	if (map == MAP_FAILED) {
+		printf("mmap error: %m\n");
+		return EXIT_FAILURE;
+	}
+	ring_size = ((struct example_ring_ctl *)map)->size;
+	munmap(map, page);
+
+	map = mmap(NULL, page + ring_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   mfd, 0);
+	if (map == MAP_FAILED) {
+		printf("mmap error: %m\n");
+		return EXIT_FAILURE;
+	}
+	ctl = map;
+	data = (unsigned char *)map + page;
+
+	if (block == 0 || block > ring_size / 2)
+		block = ring_size / 2;
+	buf = malloc(block);
+	if (buf == NULL)
+		return EXIT_FAILURE;
+	memset(buf, 'x', block);
+	printf("ring %zu KB, block %zu KB\n", ring_size >> 10, block >> 10);
+
+	/* Writers: nobody reads, so there is always room */
+	for (moved = 0; moved < total; moved += block) {
+		t = now();
+		if (write(wfd, buf, block) != (ssize_t)block) {
+			printf("write error: %m\n");
+			return EXIT_FAILURE;
+		}
+		t_write += now() - t;
+
+		t = now();
+		if (map_write(mfd, buf, block)) {
+			printf("mmap write error: %m\n");
+			return EXIT_FAILURE;
+		}
+		t_map_write += now() - t;
+	}
+
+	/*
+	 * Readers: consume every written block either way. A new reader
+	 * starts at the oldest data, which after the write phase fills the
+	 * whole ring and leaves writers no room. Drain it first, the
+	 * descriptor stays non-blocking so a miscount fails instead of
+	 * hanging.
+	 */
+	rfd = open(PROC_NODE, O_RDONLY | O_NONBLOCK);
+	if (rfd < 0) {
+		printf("open %s error: %m\n", PROC_NODE);
+		return EXIT_FAILURE;
+	}
+	while (read(rfd, buf, block) > 0)
+		;
+	for (moved = 0; moved < total; moved += block) {
+		if (write(wfd, buf, block) != (ssize_t)block) {
+			printf("write error: %m\n");
+			return EXIT_FAILURE;
+		}
+
+		t = now();
+		if (read(rfd, buf, block) != (ssize_t)block) {
+			printf("read error: %m\n");
+			return EXIT_FAILURE;
+		}
+		t_read += now() - t;
+
+		t = now();
+		if (map_read(block) < 0)
+			printf("mmap read: block was overwritten\n");
+		t_map_read += now() - t;
+	}
+
+	printf("%-8s %12s %12s\n", "", "syscall MB/s", "mmap MB/s");
+	printf("%-8s %12.1f %12.1f\n", "write", total / t_write / (1 << 20),
+	       total / t_map_write / (1 << 20));
+	printf("%-8s %12.1f %12.1f\n", "read", total / t_read / (1 << 20),
+	       total / t_map_read / (1 << 20));
+
+	munmap(map, page + ring_size);
+	free(buf);
+	close(rfd);
+	close(wfd);
+	close(mfd);
+	return EXIT_SUCCESS;
+}
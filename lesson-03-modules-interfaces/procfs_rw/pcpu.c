@@ -0,0 +1,317 @@
+
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/preempt.h>
+#include <linux/sched/clock.h>
+#include <linux/seqlock.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+#include "pcpu.h"
+#include "stats.h"
+
+
+/*
+ * Every CPU appends records to its own buffer with preemption disabled,
+ * so writers never share a lock or a cache line. A per-CPU seqcount lets
+ * readers on other CPUs copy consistent records without stopping writers.
+ * Readers merge the buffers by the records' local_clock() timestamps.
+ *
+ * Records are 16-byte aligned and never wrap: the space left at the end
+ * of the buffer is filled by a padding record instead.
+ */
+
+#define PCPU_ALIGN		16
+#define PCPU_PAD		U32_MAX
+
+struct pcpu_hdr {
+	u64 ts;
+	u32 len;
+	u32 reserved;
+};
+
+struct pcpu_buf {
+	seqcount_t seq;
+	u64 head;
+	u64 tail;
+	char *data;
+};
+
+static struct pcpu_buf __percpu *pcpu_bufs;
+static size_t pcpu_size;
+
+
+int pcpu_init(size_t capacity)
+{
+	struct pcpu_buf *buf;
+	int cpu;
+
+	pcpu_size = ALIGN(max_t(size_t, capacity, 2 * PCPU_RECORD_MAX),
+					  PCPU_ALIGN);
+
+	pcpu_bufs = alloc_percpu(struct pcpu_buf);
+	if (pcpu_bufs == NULL)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		buf = per_cpu_ptr(pcpu_bufs, cpu);
+		seqcount_init(&buf->seq);
+		buf->data = vmalloc_node(pcpu_size, cpu_to_node(cpu));
+		if (buf->data == NULL) {
+			pcpu_free();
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+
+void pcpu_free(void)
+{
+	int cpu;
+
+	if (pcpu_bufs == NULL)
+		return;
+
+	for_each_possible_cpu(cpu)
+		vfree(per_cpu_ptr(pcpu_bufs, cpu)->data);
+	free_percpu(pcpu_bufs);
+	pcpu_bufs = NULL;
+}
+
+
+u64 *pcpu_cursors_alloc(void)
+{
+	return kcalloc(nr_cpu_ids, sizeof(u64), GFP_KERNEL);
+}
+
+
+static size_t pcpu_offset(u64 pos)
+{
+	u32 offset;
+
+	div_u64_rem(pos, pcpu_size, &offset);
+	return offset;
+}
+
+
+static struct pcpu_hdr *pcpu_hdr_at(struct pcpu_buf *buf, u64 pos)
+{
+	return (struct pcpu_hdr *)(buf->data + pcpu_offset(pos));
+}
+
+
+static bool pcpu_len_valid(u32 len)
+{
+	return len == PCPU_PAD || len <= PCPU_RECORD_MAX;
+}
+
+
+/*
+ * Bytes taken by the record at pos. Only the writer walks records with
+ * it, a broken header would be a bug: skip to the end of the buffer so
+ * that the walk still terminates.
+ */
+static size_t pcpu_stride(struct pcpu_buf *buf, u64 pos)
+{
+	struct pcpu_hdr *hdr = pcpu_hdr_at(buf, pos);
+
+	if (hdr->len == PCPU_PAD || WARN_ON_ONCE(!pcpu_len_valid(hdr->len)))
+		return pcpu_size - pcpu_offset(pos);
+	return ALIGN(sizeof(*hdr) + hdr->len, PCPU_ALIGN);
+}
+
+
+/* Runs with preemption disabled, the only writer of this buffer */
+static void pcpu_append(struct pcpu_buf *buf, const char *payload, u32 len)
+{
+	struct pcpu_hdr *hdr;
+	size_t need = ALIGN(sizeof(*hdr) + len, PCPU_ALIGN);
+	size_t pad = pcpu_size - pcpu_offset(buf->head);
+
+	if (pad >= need)
+		pad = 0;
+
+	write_seqcount_begin(&buf->seq);
+
+	/* Drop the oldest records until the new one fits */
+	while (buf->head + pad + need - buf->tail > pcpu_size)
+		buf->tail += pcpu_stride(buf, buf->tail);
+
+	if (pad) {
+		hdr = pcpu_hdr_at(buf, buf->head);
+		hdr->len = PCPU_PAD;
+		buf->head += pad;
+	}
+
+	hdr = pcpu_hdr_at(buf, buf->head);
+	hdr->ts = local_clock();
+	hdr->len = len;
+	memcpy(hdr + 1, payload, len);
+	buf->head += need;
+
+	write_seqcount_end(&buf->seq);
+}
+
+
+ssize_t pcpu_write(struct iov_iter *from)
+{
+	char payload[PCPU_RECORD_MAX];
+	size_t done = 0;
+	size_t chunk;
+	size_t len;
+
+	while (iov_iter_count(from)) {
+		chunk = min_t(size_t, iov_iter_count(from), sizeof(payload));
+		/* May fault, so copy before preemption is disabled */
+		len = copy_from_iter(payload, chunk, from);
+		if (len != chunk)
+			stats_add(STAT_SHORT_COPIES, 1);
+		if (len == 0)
+			break;
+
+		preempt_disable();
+		pcpu_append(this_cpu_ptr(pcpu_bufs), payload, len);
+		preempt_enable();
+
+		done += len;
+	}
+
+	return done ? done : -EFAULT;
+}
+
+
+/*
+ * Find the next record of a CPU at or after *cursor.
+ * Moves *cursor to it and returns its timestamp, false if there is none.
+ *
+ * Headers are read while the writer may be overwriting them, so a length
+ * is only trusted after the seqcount check: a bad one ends the walk and
+ * the read starts over.
+ */
+static bool pcpu_peek(int cpu, u64 *cursor, u64 *ts)
+{
+	struct pcpu_buf *buf = per_cpu_ptr(pcpu_bufs, cpu);
+	struct pcpu_hdr *hdr;
+	unsigned int seq;
+	bool found, bad;
+	u64 pos, head;
+	u32 len;
+
+	do {
+		seq = read_seqcount_begin(&buf->seq);
+		head = buf->head;
+		pos = max(*cursor, buf->tail);
+		found = bad = false;
+		while (pos < head) {
+			hdr = pcpu_hdr_at(buf, pos);
+			len = READ_ONCE(hdr->len);
+			if (!pcpu_len_valid(len)) {
+				bad = true;
+				break;
+			}
+			if (len != PCPU_PAD) {
+				*ts = hdr->ts;
+				found = true;
+				break;
+			}
+			pos += pcpu_size - pcpu_offset(pos);
+		}
+	} while (read_seqcount_retry(&buf->seq, seq));
+
+	/* Bad under a stable seqcount: a bug, give up on this buffer */
+	if (WARN_ON_ONCE(bad)) {
+		pos = head;
+		found = false;
+	}
+
+	*cursor = pos;
+	return found;
+}
+
+
+/* Copy the payload of the record at pos, false if it was overwritten */
+static bool pcpu_copy(int cpu, u64 pos, char *payload, u32 *len)
+{
+	struct pcpu_buf *buf = per_cpu_ptr(pcpu_bufs, cpu);
+	struct pcpu_hdr *hdr;
+	unsigned int seq;
+	bool valid;
+
+	do {
+		seq = read_seqcount_begin(&buf->seq);
+		valid = pos >= buf->tail && pos < buf->head;
+		if (valid) {
+			hdr = pcpu_hdr_at(buf, pos);
+			*len = min_t(u32, READ_ONCE(hdr->len), PCPU_RECORD_MAX);
+			memcpy(payload, hdr + 1, *len);
+		}
+	} while (read_seqcount_retry(&buf->seq, seq));
+
+	return valid;
+}
+
+
+/*
+ * Fill the iterator with whole records from all CPUs, oldest first.
+ * Records committed concurrently on other CPUs may show up slightly
+ * out of order, local_clock() is not synchronized between CPUs.
+ */
+ssize_t pcpu_read(struct iov_iter *to, u64 *cursors)
+{
+	char payload[PCPU_RECORD_MAX];
+	size_t done = 0;
+	u64 ts, best_ts;
+	int cpu, best;
+	u32 len;
+
+	for (;;) {
+		best = -1;
+		best_ts = U64_MAX;
+		for_each_possible_cpu(cpu)
+			if (pcpu_peek(cpu, &cursors[cpu], &ts) && ts < best_ts) {
+				best = cpu;
+				best_ts = ts;
+			}
+		if (best < 0)
+			break;
+
+		/* Overwritten between peek and copy: look again */
+		if (!pcpu_copy(best, cursors[best], payload, &len))
+			continue;
+
+		if (len > iov_iter_count(to)) {
+			if (done == 0)
+				return -EINVAL;
+			break;
+		}
+		if (copy_to_iter(payload, len, to) != len) {
+			stats_add(STAT_SHORT_COPIES, 1);
+			return done ? done : -EFAULT;
+		}
+
+		done += len;
+		cursors[best] += ALIGN(sizeof(struct pcpu_hdr) + len,
+							   PCPU_ALIGN);
+	}
+
+	return done;
+}
+
+
+bool pcpu_empty(const u64 *cursors)
+{
+	struct pcpu_buf *buf;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		buf = per_cpu_ptr(pcpu_bufs, cpu);
+		if (max(cursors[cpu], READ_ONCE(buf->tail)) <
+			READ_ONCE(buf->head))
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,19 @@
+#ifndef _EXAMPLE_PCPU_H
+#define _EXAMPLE_PCPU_H
+
+#include <linux/types.h>
+#include <linux/uio.h>
+
+
+/* Largest payload of one record, longer writes are split */
+#define PCPU_RECORD_MAX		256
+
+
+int pcpu_init(size_t capacity);
+void pcpu_free(void);
+u64 *pcpu_cursors_alloc(void);
+ssize_t pcpu_write(struct iov_iter *from);
+ssize_t pcpu_read(struct iov_iter *to, u64 *cursors);
+bool pcpu_empty(const u64 *cursors);
+
+#endif /* _EXAMPLE_PCPU_H */
@@ -0,0 +1,224 @@
+
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+#include <linux/uio.h>
+
+#include "ring.h"
+#include "stats.h"
+
+
+int ring_init(struct example_ring *ring, size_t capacity)
+{
+	ring->max_pages = DIV_ROUND_UP(capacity, PAGE_SIZE);
+	if (ring->max_pages == 0)
+		ring->max_pages = 1;
+
+	ring->pages = kcalloc(ring->max_pages, sizeof(*ring->pages),
+						  GFP_KERNEL);
+	if (ring->pages == NULL)
+		return -ENOMEM;
+
+	ring->ctl = (struct example_ring_ctl *)get_zeroed_page(GFP_KERNEL);
+	if (ring->ctl == NULL) {
+		kfree(ring->pages);
+		ring->pages = NULL;
+		return -ENOMEM;
+	}
+
+	ring->nr_pages = 0;
+	ring->head = 0;
+	ring->tail = 0;
+
+	return 0;
+}
+
+
+void ring_free(struct example_ring *ring)
+{
+	unsigned int i;
+
+	if (ring->pages == NULL)
+		return;
+
+	/* Pages still mapped somewhere are kept alive by their mappings */
+	for (i = 0; i < ring->nr_pages; i++)
+		__free_page(ring->pages[i]);
+	kfree(ring->pages);
+	ring->pages = NULL;
+	ring->nr_pages = 0;
+
+	free_page((unsigned long)ring->ctl);
+	ring->ctl = NULL;
+}
+
+
+/* Mirror head/tail to the ctl page, seqcount style */
+static void ring_publish(struct example_ring *ring)
+{
+	struct example_ring_ctl *ctl = ring->ctl;
+
+	WRITE_ONCE(ctl->seq, ctl->seq + 1);
+	smp_wmb();
+	ctl->head = ring->head;
+	ctl->tail = ring->tail;
+	ctl->size = ring_size(ring);
+	smp_wmb();
+	WRITE_ONCE(ctl->seq, ctl->seq + 1);
+}
+
+
+/* Allocate pages so that the stream fits without wrapping up to end */
+static void ring_grow(struct example_ring *ring, u64 end)
+{
+	struct page *page;
+
+	while (ring->nr_pages < ring->max_pages && end > ring_size(ring)) {
+		page = alloc_page(GFP_KERNEL);
+		if (page == NULL)
+			break;
+		ring->pages[ring->nr_pages++] = page;
+	}
+}
+
+
+/* Address of the byte at stream position pos */
+static char *ring_addr(struct example_ring *ring, u64 pos)
+{
+	u32 offset;
+
+	div_u64_rem(pos, ring_size(ring), &offset);
+	return page_address(ring->pages[offset >> PAGE_SHIFT]) +
+		   offset_in_page(offset);
+}
+
+
+/* Bytes which can be accessed at pos without crossing a page */
+static size_t ring_chunk(u64 pos, size_t length)
+{
+	return min_t(size_t, length, PAGE_SIZE - offset_in_page(pos));
+}
+
+
+/*
+ * Append up to length bytes from the iterator, dropping the oldest data
+ * once the ring is full. A single call never writes more than the
+ * capacity, the short count tells the caller to continue.
+ */
+ssize_t ring_write(struct example_ring *ring, struct iov_iter *from,
+				   size_t length)
+{
+	size_t done = 0;
+	size_t chunk;
+	size_t copied;
+
+	length = min3(length, iov_iter_count(from), ring_capacity(ring));
+	if (length == 0)
+		return 0;
+	ring_grow(ring, ring->head + length);
+
+	/* Out of memory before reaching the capacity: don't wrap early */
+	if (ring->nr_pages < ring->max_pages)
+		length = min_t(u64, length, ring_size(ring) - ring->head);
+	if (length == 0)
+		return -ENOMEM;
+
+	while (done < length) {
+		chunk = ring_chunk(ring->head + done, length - done);
+		copied = copy_from_iter(ring_addr(ring, ring->head + done),
+								chunk, from);
+		done += copied;
+		if (copied != chunk) {
+			stats_add(STAT_SHORT_COPIES, 1);
+			break;
+		}
+	}
+
+	ring->head += done;
+	if (ring->head - ring->tail > ring_size(ring))
+		ring->tail = ring->head - ring_size(ring);
+	ring_publish(ring);
+
+	return done ? done : -EFAULT;
+}
+
+
+/*
+ * Fill the iterator with data from stream position *pos. A position
+ * which was already overwritten is moved to the oldest byte still held.
+ */
+ssize_t ring_read(struct example_ring *ring, struct iov_iter *to, u64 *pos)
+{
+	size_t done = 0;
+	size_t length;
+	size_t chunk;
+	size_t copied;
+
+	if (*pos < ring->tail)
+		*pos = ring->tail;
+	if (*pos >= ring->head)
+		return 0;
+
+	length = min_t(u64, iov_iter_count(to), ring->head - *pos);
+
+	while (done < length) {
+		chunk = ring_chunk(*pos + done, length - done);
+		copied = copy_to_iter(ring_addr(ring, *pos + done), chunk, to);
+		done += copied;
+		if (copied != chunk) {
+			stats_add(STAT_SHORT_COPIES, 1);
+			break;
+		}
+	}
+
+	*pos += done;
+
+	return done ? done : -EFAULT;
+}
+
+
+/*
+ * A mapping needs the final layout: allocate all pages up front. Called
+ * once at load time, so mmap() never has to take the ring lock.
+ */
+int ring_map_prepare(struct example_ring *ring)
+{
+	ring_grow(ring, ring_capacity(ring));
+	if (ring->nr_pages < ring->max_pages)
+		return -ENOMEM;
+
+	ring_publish(ring);
+	return 0;
+}
+
+
+/* Page number pgoff of the mapping: ctl page first, then ring data */
+struct page *ring_map_page(struct example_ring *ring, unsigned long pgoff)
+{
+	if (pgoff == 0)
+		return virt_to_page(ring->ctl);
+	if (pgoff > ring->nr_pages)
+		return NULL;
+	return ring->pages[pgoff - 1];
+}
+
+
+/*
+ * Make length bytes stored at head through a mapping visible. head is
+ * where the writer placed them, anything written since invalidates that.
+ */
+int ring_commit(struct example_ring *ring, u64 head, size_t length)
+{
+	if (ring->nr_pages < ring->max_pages || length > ring_size(ring))
+		return -EINVAL;
+	if (head != ring->head)
+		return -EAGAIN;
+
+	ring->head += length;
+	if (ring->head - ring->tail > ring_size(ring))
+		ring->tail = ring->head - ring_size(ring);
+	ring_publish(ring);
+
+	return 0;
+}
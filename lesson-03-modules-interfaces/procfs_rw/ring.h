@@ -0,0 +1,48 @@
+#ifndef _EXAMPLE_RING_H
+#define _EXAMPLE_RING_H
+
+#include <linux/types.h>
+#include <linux/mm_types.h>
+#include <linux/uio.h>
+
+#include "example_mmap.h"
+
+
+/*
+ * Byte stream kept in separately allocated pages.
+ * Positions are absolute stream offsets: head is where the next byte is
+ * written, tail is the oldest byte still held. Pages are added on demand
+ * until max_pages is reached, only then the ring starts to wrap.
+ * head and tail are mirrored to the ctl page for mmap() users.
+ * Locking is up to the caller.
+ */
+struct example_ring {
+	struct page **pages;
+	unsigned int nr_pages;
+	unsigned int max_pages;
+	u64 head;
+	u64 tail;
+	struct example_ring_ctl *ctl;
+};
+
+
+int ring_init(struct example_ring *ring, size_t capacity);
+void ring_free(struct example_ring *ring);
+ssize_t ring_write(struct example_ring *ring, struct iov_iter *from,
+				   size_t length);
+ssize_t ring_read(struct example_ring *ring, struct iov_iter *to, u64 *pos);
+int ring_map_prepare(struct example_ring *ring);
+struct page *ring_map_page(struct example_ring *ring, unsigned long pgoff);
+int ring_commit(struct example_ring *ring, u64 head, size_t length);
+
+static inline size_t ring_size(const struct example_ring *ring)
+{
+	return (size_t)ring->nr_pages << PAGE_SHIFT;
+}
+
+static inline size_t ring_capacity(const struct example_ring *ring)
+{
+	return (size_t)ring->max_pages << PAGE_SHIFT;
+}
+
+#endif /* _EXAMPLE_RING_H */
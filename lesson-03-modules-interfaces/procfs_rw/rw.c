@@ -5,6 +5,18 @@
 #include <linux/sched.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
+#include <linux/rwsem.h>
+#include <linux/list.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/uio.h>
+#include <linux/mm.h>
+#include <linux/sched/clock.h>
+
+#include "ring.h"
+#include "pcpu.h"
+#include "stats.h"
+#include "example_mmap.h"
 
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_AUTHOR("Aleksandr Bulyshchenko <A.Bulyshchenko@globallogic.com>");
@@ -15,45 +27,104 @@ MODULE_VERSION("0.1");
 #define MODULE_TAG		"example_module "
 #define PROC_DIRECTORY	"example"
 #define PROC_FILENAME	"buffer"
-#define BUFFER_SIZE		10
 
 
-static char *proc_buffer;
-static size_t proc_msg_length;
-static size_t proc_msg_read_pos;
+static unsigned int capacity = 64 * 1024;
+module_param(capacity, uint, 0444);
+MODULE_PARM_DESC(capacity, "buffer capacity in bytes, rounded up to pages");
+
+static bool percpu;
+module_param(percpu, bool, 0444);
+MODULE_PARM_DESC(percpu, "per-CPU record buffers of 'capacity' bytes each, merged on read");
+
+static bool mappable;
+module_param(mappable, bool, 0444);
+MODULE_PARM_DESC(mappable, "allocate the whole ring at load time and allow mmap()");
+
+/*
+ * Written data is appended to the ring, every open file reads it from its
+ * own position. Readers only share the lock, writers take it exclusively.
+ *
+ * The node behaves like a pipe: readers wait for new data, writers wait
+ * until the slowest open reader has consumed enough to make room.
+ * Without readers nothing is waited for and the oldest data is dropped.
+ */
+static struct example_ring proc_ring;
+static DECLARE_RWSEM(proc_ring_lock);
+
+struct example_reader {
+	struct list_head list;
+	u64 pos;
+	u64 *cursors;	/* per-CPU read positions in percpu mode */
+	bool mapped;	/* reads through a mapping, writers don't wait for it */
+};
 
-static struct proc_dir_entry *proc_dir;
-static struct proc_dir_entry *proc_file;
+static LIST_HEAD(proc_readers);
 
-static int example_read(struct file *file_p, char __user *buffer,
-						size_t length, loff_t *offset);
-static int example_write(struct file *file_p, const char __user *buffer,
-						 size_t length, loff_t *offset);
+/* Bumped on every write/read, waiters sleep until the counter changes */
+static atomic_t proc_write_events = ATOMIC_INIT(0);
+static atomic_t proc_read_events = ATOMIC_INIT(0);
+static DECLARE_WAIT_QUEUE_HEAD(proc_read_wait);
+static DECLARE_WAIT_QUEUE_HEAD(proc_write_wait);
 
+static struct proc_dir_entry *proc_dir;
+static struct proc_dir_entry *proc_file;
+static bool proc_stats;
+
+static int example_open(struct inode *inode, struct file *file_p);
+static int example_release(struct inode *inode, struct file *file_p);
+static ssize_t example_read_iter(struct kiocb *iocb, struct iov_iter *to);
+static ssize_t example_write_iter(struct kiocb *iocb, struct iov_iter *from);
+static ssize_t example_read(struct file *file_p, char __user *buffer,
+							size_t length, loff_t *offset);
+static ssize_t example_write(struct file *file_p, const char __user *buffer,
+							 size_t length, loff_t *offset);
+static unsigned int example_poll(struct file *file_p, poll_table *wait);
+static int example_mmap(struct file *file_p, struct vm_area_struct *vma);
+static long example_ioctl(struct file *file_p, unsigned int cmd,
+						  unsigned long arg);
+
+/*
+ * procfs of this kernel generation dispatches only .read and .write to
+ * the entry, never .read_iter/.write_iter or the splice handlers. The
+ * ring code copies through an iov_iter anyway and .read/.write wrap it
+ * in a single-segment iterator. readv()/writev() therefore take the lock
+ * once per segment. splice() and sendfile() go through
+ * default_file_splice_read/write, which copy the data via .read/.write
+ * into pipe pages, so they are not zero-copy here.
+ */
 static const struct file_operations proc_fops = {
-	.read  = example_read,
-	.write = example_write,
+	.open         = example_open,
+	.release      = example_release,
+	.read         = example_read,
+	.write        = example_write,
+	.poll         = example_poll,
+	.mmap         = example_mmap,
+	.unlocked_ioctl = example_ioctl,
+	.llseek       = no_llseek,
 };
 
 
 static int create_buffer(void)
 {
-	proc_buffer = kmalloc(BUFFER_SIZE, GFP_KERNEL);
-	if (proc_buffer == NULL)
-		return -ENOMEM;
-	proc_msg_length = 0;
+	int err;
 
-	return 0;
+	if (percpu)
+		return pcpu_init(capacity);
+
+	err = ring_init(&proc_ring, capacity);
+	if (!err && mappable)
+		err = ring_map_prepare(&proc_ring);
+	return err;
 }
 
 
 static void cleanup_buffer(void)
 {
-	if (proc_buffer) {
-		kfree(proc_buffer);
-		proc_buffer = NULL;
-	}
-	proc_msg_length = 0;
+	if (percpu)
+		pcpu_free();
+	else
+		ring_free(&proc_ring);
 }
 
 
@@ -68,12 +139,20 @@ static int create_proc_example(void)
 	if (proc_file == NULL)
 		return -EFAULT;
 
+	if (stats_create(proc_dir))
+		return -EFAULT;
+	proc_stats = true;
+
 	return 0;
 }
 
 
 static void cleanup_proc_example(void)
 {
+	if (proc_stats) {
+		stats_remove(proc_dir);
+		proc_stats = false;
+	}
 	if (proc_file) {
 		remove_proc_entry(PROC_FILENAME, proc_dir);
 		proc_file = NULL;
@@ -85,53 +164,410 @@ static void cleanup_proc_example(void)
 }
 
 
-static int example_read(struct file *file_p, char __user *buffer,
-						size_t length, loff_t *offset)
+/* Free room for writers, proc_ring_lock must be held */
+static size_t example_space(void)
 {
-	size_t left;
+	struct example_reader *reader;
+	u64 oldest = proc_ring.head;
 
-	if (length > (proc_msg_length - proc_msg_read_pos))
-		length = (proc_msg_length - proc_msg_read_pos);
+	if (list_empty(&proc_readers))
+		return ring_capacity(&proc_ring);
 
-	left = copy_to_user(buffer, &proc_buffer[proc_msg_read_pos], length);
+	list_for_each_entry(reader, &proc_readers, list)
+		if (!READ_ONCE(reader->mapped))
+			oldest = min(oldest, max(reader->pos, proc_ring.tail));
 
-	proc_msg_read_pos += length - left;
+	return ring_capacity(&proc_ring) - (proc_ring.head - oldest);
+}
 
-	if (left)
-		pr_err(MODULE_TAG "failed to read %u from %u chars\n",
-			   left, length);
-	else
-		pr_notice(MODULE_TAG "read %u chars\n", length);
 
-	return length - left;
+static int example_open(struct inode *inode, struct file *file_p)
+{
+	struct example_reader *reader;
+
+	if (file_p->f_mode & FMODE_READ) {
+		reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+		if (reader == NULL)
+			return -ENOMEM;
+
+		if (percpu) {
+			reader->cursors = pcpu_cursors_alloc();
+			if (reader->cursors == NULL) {
+				kfree(reader);
+				return -ENOMEM;
+			}
+		}
+
+		down_write(&proc_ring_lock);
+		reader->pos = proc_ring.tail;
+		list_add(&reader->list, &proc_readers);
+		up_write(&proc_ring_lock);
+
+		file_p->f_pos = reader->pos;
+		file_p->private_data = reader;
+	}
+
+	return nonseekable_open(inode, file_p);
 }
 
 
-static int example_write(struct file *file_p, const char __user *buffer,
-						 size_t length, loff_t *offset)
+static int example_release(struct inode *inode, struct file *file_p)
 {
-	size_t msg_length;
-	size_t left;
+	struct example_reader *reader = file_p->private_data;
+
+	if (reader) {
+		down_write(&proc_ring_lock);
+		list_del_init(&reader->list);
+		up_write(&proc_ring_lock);
+		kfree(reader->cursors);
+		kfree(reader);
+
+		/* The slowest reader may be gone */
+		atomic_inc(&proc_read_events);
+		wake_up_interruptible(&proc_write_wait);
+	}
+
+	return 0;
+}
 
-	if (length > BUFFER_SIZE) {
-		pr_warn(MODULE_TAG "reduse message length from %u to %u chars\n",
-				length, BUFFER_SIZE);
-		msg_length = BUFFER_SIZE;
-	} else
-		msg_length = length;
 
-	left = copy_from_user(proc_buffer, buffer, msg_length);
+static bool example_nonblock(struct kiocb *iocb)
+{
+	return (iocb->ki_filp->f_flags & O_NONBLOCK) ||
+		   (iocb->ki_flags & IOCB_NOWAIT);
+}
 
-	proc_msg_length = msg_length - left;
-	proc_msg_read_pos = 0;
 
-	if (left)
-		pr_err(MODULE_TAG "failed to write %u from %u chars\n",
-			   left, msg_length);
-	else
-		pr_notice(MODULE_TAG "written %u chars\n", msg_length);
+/*
+ * Latency is measured from the last attempt only, time spent sleeping
+ * on the wait queues is not part of it.
+ */
+static void example_account_read(ssize_t ret, u64 start)
+{
+	stats_latency(false, local_clock() - start);
+	stats_add(STAT_READS, 1);
+	if (ret > 0)
+		stats_add(STAT_BYTES_OUT, ret);
+}
+
+
+static void example_account_write(ssize_t ret, size_t length, u64 start)
+{
+	stats_latency(true, local_clock() - start);
+	stats_add(STAT_WRITES, 1);
+	if (ret > 0)
+		stats_add(STAT_BYTES_IN, ret);
+	if (ret >= 0 && ret < length)
+		stats_add(STAT_TRUNCATIONS, 1);
+}
+
+
+/* Lockless path: writers never wait, readers merge all CPUs' records */
+static ssize_t example_pcpu_read(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct example_reader *reader = iocb->ki_filp->private_data;
+	size_t length = iov_iter_count(to);
+	ssize_t ret;
+	u64 start;
+
+	for (;;) {
+		start = local_clock();
+		ret = pcpu_read(to, reader->cursors);
+		if (ret || length == 0)
+			break;
+		if (example_nonblock(iocb))
+			return -EAGAIN;
+		if (wait_event_interruptible(proc_read_wait,
+				!pcpu_empty(reader->cursors)))
+			return -ERESTARTSYS;
+	}
+
+	example_account_read(ret, start);
+	if (ret < 0) {
+		pr_err_ratelimited(MODULE_TAG "failed to read %zu chars\n", length);
+		return ret;
+	}
+
+	iocb->ki_pos += ret;
+	pr_debug(MODULE_TAG "read %zd chars\n", ret);
+
+	return ret;
+}
+
+
+static ssize_t example_pcpu_write(struct kiocb *iocb, struct iov_iter *from)
+{
+	size_t length = iov_iter_count(from);
+	ssize_t ret;
+	u64 start;
+
+	if (length == 0)
+		return 0;
+
+	start = local_clock();
+	ret = pcpu_write(from);
+	example_account_write(ret, length, start);
+	if (ret < 0) {
+		pr_err_ratelimited(MODULE_TAG "failed to write %zu chars\n", length);
+		return ret;
+	}
+
+	pr_debug(MODULE_TAG "written %zd chars\n", ret);
+	/* Don't touch the wait queue lock unless somebody sleeps */
+	if (wq_has_sleeper(&proc_read_wait))
+		wake_up_interruptible(&proc_read_wait);
+
+	return ret;
+}
+
+
+static ssize_t example_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct example_reader *reader = iocb->ki_filp->private_data;
+	size_t length = iov_iter_count(to);
+	u64 pos;
+	int events;
+	ssize_t ret;
+	u64 start;
+
+	if (percpu)
+		return example_pcpu_read(iocb, to);
+
+	for (;;) {
+		start = local_clock();
+		down_read(&proc_ring_lock);
+		pos = iocb->ki_pos;
+		ret = ring_read(&proc_ring, to, &pos);
+		reader->pos = pos;
+		events = atomic_read(&proc_write_events);
+		up_read(&proc_ring_lock);
+
+		if (ret || length == 0)
+			break;
+		if (example_nonblock(iocb))
+			return -EAGAIN;
+		if (wait_event_interruptible(proc_read_wait,
+				atomic_read(&proc_write_events) != events))
+			return -ERESTARTSYS;
+	}
+
+	example_account_read(ret, start);
+	if (ret < 0) {
+		pr_err_ratelimited(MODULE_TAG "failed to read %zu chars\n", length);
+		return ret;
+	}
+
+	iocb->ki_pos = pos;
+	pr_debug(MODULE_TAG "read %zd chars\n", ret);
+
+	if (ret) {
+		atomic_inc(&proc_read_events);
+		wake_up_interruptible(&proc_write_wait);
+	}
+
+	return ret;
+}
+
+
+/*
+ * Writes as much as fits right now and blocks only when nothing fits,
+ * so a blocking write may return a short count.
+ */
+static ssize_t example_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	size_t length = iov_iter_count(from);
+	size_t space;
+	int events;
+	ssize_t ret = 0;
+	u64 start;
+
+	if (percpu)
+		return example_pcpu_write(iocb, from);
+
+	if (length == 0)
+		return 0;
+
+	for (;;) {
+		start = local_clock();
+		down_write(&proc_ring_lock);
+		space = example_space();
+		if (space) {
+			ret = ring_write(&proc_ring, from, space);
+			if (ret > 0)
+				atomic_inc(&proc_write_events);
+		}
+		events = atomic_read(&proc_read_events);
+		up_write(&proc_ring_lock);
+
+		if (space)
+			break;
+		if (example_nonblock(iocb))
+			return -EAGAIN;
+		if (wait_event_interruptible(proc_write_wait,
+				atomic_read(&proc_read_events) != events))
+			return -ERESTARTSYS;
+	}
+
+	example_account_write(ret, length, start);
+	if (ret < 0) {
+		pr_err_ratelimited(MODULE_TAG "failed to write %zu chars\n", length);
+		return ret;
+	}
+
+	pr_debug(MODULE_TAG "written %zd chars\n", ret);
+	wake_up_interruptible(&proc_read_wait);
+
+	return ret;
+}
+
+
+static ssize_t example_read(struct file *file_p, char __user *buffer,
+							size_t length, loff_t *offset)
+{
+	struct iovec iov = { .iov_base = buffer, .iov_len = length };
+	struct kiocb kiocb;
+	struct iov_iter iter;
+	ssize_t ret;
+
+	init_sync_kiocb(&kiocb, file_p);
+	kiocb.ki_pos = *offset;
+	iov_iter_init(&iter, READ, &iov, 1, length);
+
+	ret = example_read_iter(&kiocb, &iter);
+	*offset = kiocb.ki_pos;
+
+	return ret;
+}
+
+
+static ssize_t example_write(struct file *file_p, const char __user *buffer,
+							 size_t length, loff_t *offset)
+{
+	struct iovec iov = { .iov_base = (void __user *)buffer,
+						 .iov_len = length };
+	struct kiocb kiocb;
+	struct iov_iter iter;
+	ssize_t ret;
+
+	init_sync_kiocb(&kiocb, file_p);
+	kiocb.ki_pos = *offset;
+	iov_iter_init(&iter, WRITE, &iov, 1, length);
+
+	ret = example_write_iter(&kiocb, &iter);
+	*offset = kiocb.ki_pos;
 
-	return length;
+	return ret;
+}
+
+
+static unsigned int example_poll(struct file *file_p, poll_table *wait)
+{
+	struct example_reader *reader = file_p->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(file_p, &proc_read_wait, wait);
+	poll_wait(file_p, &proc_write_wait, wait);
+
+	if (percpu) {
+		if (reader && !pcpu_empty(reader->cursors))
+			mask |= POLLIN | POLLRDNORM;
+		if (file_p->f_mode & FMODE_WRITE)
+			mask |= POLLOUT | POLLWRNORM;
+		return mask;
+	}
+
+	down_read(&proc_ring_lock);
+	if (reader && max(reader->pos, proc_ring.tail) < proc_ring.head)
+		mask |= POLLIN | POLLRDNORM;
+	if ((file_p->f_mode & FMODE_WRITE) && example_space())
+		mask |= POLLOUT | POLLWRNORM;
+	up_read(&proc_ring_lock);
+
+	return mask;
+}
+
+
+/*
+ * Called with mmap_sem held, while read() and write() hold proc_ring_lock
+ * across user copies that may fault and take mmap_sem. So this must not
+ * take proc_ring_lock: the pages were all allocated at load time and
+ * never change, and the reader is only flagged.
+ */
+static int example_mmap(struct file *file_p, struct vm_area_struct *vma)
+{
+	struct example_reader *reader = file_p->private_data;
+	unsigned long pages = vma_pages(vma);
+	unsigned long i;
+	int err;
+
+	if (percpu || !mappable)
+		return -EOPNOTSUPP;
+	if (vma->vm_pgoff + pages > 1 + proc_ring.max_pages)
+		return -EINVAL;
+
+	/* Mapped readers look at the latest data, writers don't wait for them */
+	if (reader) {
+		WRITE_ONCE(reader->mapped, true);
+		atomic_inc(&proc_read_events);
+		wake_up_interruptible(&proc_write_wait);
+	}
+
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+	for (i = 0; i < pages; i++) {
+		err = vm_insert_page(vma, vma->vm_start + i * PAGE_SIZE,
+				ring_map_page(&proc_ring, vma->vm_pgoff + i));
+		if (err) {
+			if (reader)
+				WRITE_ONCE(reader->mapped, false);
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+
+static long example_ioctl(struct file *file_p, unsigned int cmd,
+						  unsigned long arg)
+{
+	struct example_ring_commit commit;
+	size_t space;
+	int err;
+
+	if (percpu)
+		return -EOPNOTSUPP;
+
+	switch (cmd) {
+	case EXAMPLE_IOC_SPACE:
+		down_read(&proc_ring_lock);
+		space = example_space();
+		up_read(&proc_ring_lock);
+		return min_t(size_t, space, INT_MAX);
+
+	case EXAMPLE_IOC_COMMIT:
+		if (!(file_p->f_mode & FMODE_WRITE))
+			return -EBADF;
+		if (!mappable)
+			return -EOPNOTSUPP;
+		if (copy_from_user(&commit, (void __user *)arg, sizeof(commit)))
+			return -EFAULT;
+
+		down_write(&proc_ring_lock);
+		if (commit.length > example_space())
+			err = -ENOSPC;
+		else
+			err = ring_commit(&proc_ring, commit.head, commit.length);
+		if (!err)
+			atomic_inc(&proc_write_events);
+		up_write(&proc_ring_lock);
+
+		if (!err)
+			wake_up_interruptible(&proc_read_wait);
+		return err;
+
+	default:
+		return -ENOTTY;
+	}
 }
 
 
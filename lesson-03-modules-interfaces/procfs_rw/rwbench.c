@@ -0,0 +1,209 @@
+/*
+ * Throughput of /proc/example/buffer for transfer sizes from 4 KB to 1 MB.
+ *
+ * One file is used for writing and another one for reading, each with its
+ * own position. Every round writes one block and drains it again with one
+ * of the read paths:
+ *   read     - read() into a user buffer
+ *   readv    - readv() with the block split into 4 iovecs
+ *   splice   - splice() into a pipe, then from the pipe to /dev/null
+ *   sendfile - sendfile() straight to /dev/null
+ *
+ * The procfs node has only .read/.write, so readv() reads once per iovec
+ * and splice()/sendfile() copy through default_file_splice_read(). The
+ * comparison shows the cost of those fallbacks, not of zero-copy paths.
+ *
+ * A write never stores more than the ring capacity, so sizes above it are
+ * skipped. The capacity is taken from the module parameter, or from the
+ * second argument when the parameter can't be read.
+ *
+ * usage: rwbench [MB per size and method] [capacity KB]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+
+#define PROC_NODE	"/proc/example/buffer"
+#define CAPACITY_PARAM	"/sys/module/procfs_rw/parameters/capacity"
+#define MAX_SIZE	(1 << 20)
+
+enum method { M_READ, M_READV, M_SPLICE, M_SENDFILE, M_NUM };
+
+static const char * const method_names[M_NUM] = {
+	"read", "readv", "splice", "sendfile",
+};
+
+static int wfd, rfd, nullfd, pipefd[2];
+static char *buf;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Ring capacity in bytes as the module rounds it, 0 if unknown */
+static size_t ring_capacity(void)
+{
+	unsigned long capacity;
+	long page = sysconf(_SC_PAGESIZE);
+	FILE *f = fopen(CAPACITY_PARAM, "r");
+	int ok;
+
+	if (f == NULL)
+		return 0;
+	ok = fscanf(f, "%lu", &capacity) == 1;
+	fclose(f);
+	if (!ok)
+		return 0;
+	if (capacity == 0)
+		capacity = 1;
+	return (capacity + page - 1) / page * page;
+}
+
+/* Consume up to size bytes with the given method */
+static ssize_t drain(enum method m, size_t size)
+{
+	struct iovec iov[4];
+	ssize_t n, out;
+	int i;
+
+	switch (m) {
+	case M_READ:
+		return read(rfd, buf, size);
+	case M_READV:
+		for (i = 0; i < 4; i++) {
+			iov[i].iov_base = buf + i * (size / 4);
+			iov[i].iov_len = size / 4;
+		}
+		return readv(rfd, iov, 4);
+	case M_SPLICE:
+		n = splice(rfd, NULL, pipefd[1], NULL, size, SPLICE_F_MOVE);
+		for (out = 0; n > 0 && out < n; ) {
+			ssize_t r = splice(pipefd[0], NULL, nullfd, NULL,
+					   n - out, SPLICE_F_MOVE);
+			if (r <= 0)
+				return -1;
+			out += r;
+		}
+		return n;
+	case M_SENDFILE:
+		return sendfile(nullfd, rfd, NULL, size);
+	default:
+		return -1;
+	}
+}
+
+/* Returns read MB/s or a negative value on error */
+static double run(enum method m, size_t size, size_t total, double *wrate)
+{
+	size_t moved = 0;
+	double t, wtime = 0, rtime = 0;
+	ssize_t w, r, got;
+	size_t chunk = size;
+
+	/* A pipe holds 64 KB by default */
+	if (m == M_SPLICE && chunk > 65536)
+		chunk = 65536;
+
+	while (moved < total) {
+		t = now();
+		w = write(wfd, buf, size);
+		wtime += now() - t;
+		if (w <= 0) {
+			printf("write error: %m\n");
+			return -1;
+		}
+
+		t = now();
+		for (got = 0; got < w; got += r) {
+			r = drain(m, chunk < (size_t)(w - got) ? chunk : w - got);
+			if (r <= 0) {
+				printf("%s error (%zd): %m\n", method_names[m], r);
+				return -1;
+			}
+		}
+		rtime += now() - t;
+		moved += w;
+	}
+
+	*wrate = moved / wtime / (1 << 20);
+	return moved / rtime / (1 << 20);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t total = (argc > 1 ? atol(argv[1]) : 64) << 20;
+	size_t capacity = ring_capacity();
+	size_t size;
+	double rate, wrate, wsum;
+	int m;
+
+	wfd = open(PROC_NODE, O_WRONLY);
+	rfd = open(PROC_NODE, O_RDONLY | O_NONBLOCK);
+	nullfd = open("/dev/null", O_WRONLY);
+	if (wfd < 0 || rfd < 0 || nullfd < 0 || pipe(pipefd)) {
+		printf("open %s error: %m\n", PROC_NODE);
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 2)
+		capacity = (size_t)atol(argv[2]) << 10;
+	if (capacity == 0) {
+		printf("can't read %s, pass the capacity in KB\n", CAPACITY_PARAM);
+		return EXIT_FAILURE;
+	}
+
+	buf = malloc(MAX_SIZE);
+	if (buf == NULL)
+		return EXIT_FAILURE;
+	memset(buf, 'x', MAX_SIZE);
+
+	/* Skip whatever is already in the buffer, then read blocking */
+	while (read(rfd, buf, MAX_SIZE) > 0)
+		;
+	fcntl(rfd, F_SETFL, 0);
+
+	printf("ring capacity %zu KB\n", capacity >> 10);
+	printf("%8s %12s", "size KB", "write MB/s");
+	for (m = 0; m < M_NUM; m++)
+		printf(" %10s", method_names[m]);
+	printf("   (read MB/s)\n");
+
+	for (size = 4096; size <= MAX_SIZE; size *= 4) {
+		char line[128];
+		int len = 0;
+
+		if (size > capacity) {
+			printf("%8zu   skipped, above the ring capacity\n",
+			       size / 1024);
+			continue;
+		}
+		wsum = 0;
+		for (m = 0; m < M_NUM; m++) {
+			rate = run(m, size, total, &wrate);
+			if (rate < 0)
+				return EXIT_FAILURE;
+			wsum += wrate;
+			len += snprintf(line + len, sizeof(line) - len,
+					" %10.1f", rate);
+		}
+		printf("%8zu %12.1f%s\n", size / 1024, wsum / M_NUM, line);
+	}
+
+	free(buf);
+	close(pipefd[0]);
+	close(pipefd[1]);
+	close(nullfd);
+	close(rfd);
+	close(wfd);
+	return EXIT_SUCCESS;
+}
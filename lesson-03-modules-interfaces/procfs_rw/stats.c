@@ -0,0 +1,113 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
+
+#include "stats.h"
+
+
+#define STATS_FILENAME	"stats"
+
+
+DEFINE_PER_CPU(struct example_stats, example_stats);
+
+static const char * const stats_names[STAT_NUM] = {
+	[STAT_READS]		= "reads",
+	[STAT_WRITES]		= "writes",
+	[STAT_BYTES_IN]		= "bytes_in",
+	[STAT_BYTES_OUT]	= "bytes_out",
+	[STAT_TRUNCATIONS]	= "truncations",
+	[STAT_SHORT_COPIES]	= "short_copies",
+};
+
+
+void stats_latency(bool write, u64 ns)
+{
+	unsigned int bucket = ns ? ilog2(ns) : 0;
+
+	bucket = min_t(unsigned int, bucket, STATS_LAT_BUCKETS - 1);
+	if (write)
+		this_cpu_inc(example_stats.write_lat[bucket]);
+	else
+		this_cpu_inc(example_stats.read_lat[bucket]);
+}
+
+
+/*
+ * Sums are taken without stopping the writers, so counters read together
+ * may be a few calls apart. Good enough for monitoring.
+ */
+static int stats_show(struct seq_file *m, void *v)
+{
+	struct example_stats *sum;
+	struct example_stats *st;
+	int first = -1;
+	int last = -1;
+	int cpu;
+	int i;
+
+	sum = kzalloc(sizeof(*sum), GFP_KERNEL);
+	if (sum == NULL)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		st = per_cpu_ptr(&example_stats, cpu);
+		for (i = 0; i < STAT_NUM; i++)
+			sum->count[i] += READ_ONCE(st->count[i]);
+		for (i = 0; i < STATS_LAT_BUCKETS; i++) {
+			sum->read_lat[i] += READ_ONCE(st->read_lat[i]);
+			sum->write_lat[i] += READ_ONCE(st->write_lat[i]);
+		}
+	}
+
+	for (i = 0; i < STAT_NUM; i++)
+		seq_printf(m, "%-13s %llu\n", stats_names[i], sum->count[i]);
+
+	for (i = 0; i < STATS_LAT_BUCKETS; i++) {
+		if (sum->read_lat[i] || sum->write_lat[i]) {
+			if (first < 0)
+				first = i;
+			last = i;
+		}
+	}
+
+	seq_printf(m, "\n%-13s %12s %12s\n", "latency_ns", "reads", "writes");
+	for (i = first; first >= 0 && i <= last; i++)
+		seq_printf(m, "<%-12llu %12llu %12llu\n", 2ULL << i,
+				   sum->read_lat[i], sum->write_lat[i]);
+
+	kfree(sum);
+	return 0;
+}
+
+
+static int stats_open(struct inode *inode, struct file *file_p)
+{
+	return single_open(file_p, stats_show, NULL);
+}
+
+
+static const struct file_operations stats_fops = {
+	.owner   = THIS_MODULE,
+	.open    = stats_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+
+int stats_create(struct proc_dir_entry *dir)
+{
+	if (proc_create(STATS_FILENAME, S_IFREG | S_IRUGO, dir,
+					&stats_fops) == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+
+
+void stats_remove(struct proc_dir_entry *dir)
+{
+	remove_proc_entry(STATS_FILENAME, dir);
+}
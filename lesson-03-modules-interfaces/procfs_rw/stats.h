@@ -0,0 +1,41 @@
+#ifndef _EXAMPLE_STATS_H
+#define _EXAMPLE_STATS_H
+
+#include <linux/types.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+
+
+enum example_stat {
+	STAT_READS,
+	STAT_WRITES,
+	STAT_BYTES_IN,
+	STAT_BYTES_OUT,
+	STAT_TRUNCATIONS,	/* writes which accepted less than requested */
+	STAT_SHORT_COPIES,	/* user copies which faulted part way */
+	STAT_NUM,
+};
+
+/* Bucket n counts calls which took [2^n, 2^(n+1)) ns */
+#define STATS_LAT_BUCKETS	32
+
+struct example_stats {
+	u64 count[STAT_NUM];
+	u64 read_lat[STATS_LAT_BUCKETS];
+	u64 write_lat[STATS_LAT_BUCKETS];
+};
+
+DECLARE_PER_CPU(struct example_stats, example_stats);
+
+
+/* Cheap enough for every call: no shared cache lines, no atomics */
+static inline void stats_add(enum example_stat stat, u64 value)
+{
+	this_cpu_add(example_stats.count[stat], value);
+}
+
+void stats_latency(bool write, u64 ns);
+int stats_create(struct proc_dir_entry *dir);
+void stats_remove(struct proc_dir_entry *dir);
+
+#endif /* _EXAMPLE_STATS_H */
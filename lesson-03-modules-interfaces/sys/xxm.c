@@ -5,82 +5,294 @@
 #include <linux/pci.h>
 #include <linux/version.h>
 #include <linux/init.h>
+#include <linux/device.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
 
 #define LEN_MSG 160
 
-#if LINUX_VERSION_CODE > KERNEL_VERSION(2,6,32) 
-
-#define IOFUNCS( name )                                                         \
-static char buf_##name[ LEN_MSG + 1 ] = "не инициализировано "#name"\n";        \
-static ssize_t SHOW_##name( struct class *class, struct class_attribute *attr,  \
-                            char *buf ) {                                       \
-   strcpy( buf, buf_##name );                                                   \
-   printk( "read %ld\n", (long)strlen( buf ) );                                 \
-   return strlen( buf );                                                        \
-}                                                                               \
-static ssize_t STORE_##name( struct class *class, struct class_attribute *attr, \
-                             const char *buf, size_t count ) {                  \
-   printk( "write %ld\n", (long)count );                                        \
-   strncpy( buf_##name, buf, count );                                           \
-   buf_##name[ count ] = '\0';                                                  \
-   return count;                                                                \
+/* Every attribute, static or created at runtime, keeps its value in an
+   object from one kmem_cache */
+struct xxm_value {
+   spinlock_t lock;
+   size_t len;
+   char data[ LEN_MSG + 1 ];
+};
+
+static struct kmem_cache *xxm_cache;
+
+static struct xxm_value *xxm_value_alloc( const char *init ) {
+   struct xxm_value *val = kmem_cache_alloc( xxm_cache, GFP_KERNEL );
+   if( val ) {
+      spin_lock_init( &val->lock );
+      val->len = strlcpy( val->data, init, sizeof( val->data ) );
+   }
+   return val;
+}
+
+static ssize_t xxm_value_show( struct xxm_value *val, char *buf ) {
+   size_t len;
+   spin_lock( &val->lock );
+   len = val->len;
+   memcpy( buf, val->data, len );
+   spin_unlock( &val->lock );
+   return len;
+}
+
+static ssize_t xxm_value_store( struct xxm_value *val, const char *buf, size_t count ) {
+   size_t len = min_t( size_t, count, LEN_MSG );
+   spin_lock( &val->lock );
+   memcpy( val->data, buf, len );
+   val->data[ len ] = '\0';
+   val->len = len;
+   spin_unlock( &val->lock );
+   return count;
+}
+
+/* Static attributes: one table instead of a macro expansion per name */
+struct xxm_class_attr {
+   struct class_attribute attr;
+   struct xxm_value *val;
+};
+
+static ssize_t xxm_class_show( struct class *class, struct class_attribute *attr,
+                               char *buf ) {
+   return xxm_value_show( container_of( attr, struct xxm_class_attr, attr )->val, buf );
 }
 
-#else 
-
-#define IOFUNCS( name )                                                         \
-static char buf_##name[ LEN_MSG + 1 ] = "не инициализировано "#name"\n";        \
-static ssize_t SHOW_##name( struct class *class, char *buf ) {                  \
-   strcpy( buf, buf_##name );                                                   \
-   printk( "read %ld\n", (long)strlen( buf ) );                                 \
-   return strlen( buf );                                                        \
-}                                                                               \
-static ssize_t STORE_##name( struct class *class, const char *buf,              \
-                             size_t count ) {                                   \
-   printk( "write %ld\n", (long)count );                                        \
-   strncpy( buf_##name, buf, count );                                           \
-   buf_##name[ count ] = '\0';                                                  \
-   return count;                                                                \
+static ssize_t xxm_class_store( struct class *class, struct class_attribute *attr,
+                                const char *buf, size_t count ) {
+   return xxm_value_store( container_of( attr, struct xxm_class_attr, attr )->val,
+                           buf, count );
 }
 
-#endif 
+#define XXM_ATTR( name ) \
+   { .attr = __ATTR( name, ( S_IWUSR | S_IRUGO ), xxm_class_show, xxm_class_store ) }
 
-IOFUNCS( data1 );
-IOFUNCS( data2 );
-IOFUNCS( data3 );
+static struct xxm_class_attr xxm_attrs[] = {
+   XXM_ATTR( data1 ),
+   XXM_ATTR( data2 ),
+   XXM_ATTR( data3 ),
+};
 
-#define OWN_CLASS_ATTR( name ) \
-   struct class_attribute class_attr_##name = \
-   __ATTR( name, ( S_IWUSR | S_IRUGO ), &SHOW_##name, &STORE_##name )
-// ( S_IWUSR | S_IRUGO ),
-//   __ATTR( name, 0666, &SHOW_##name, &STORE_##name )
+/* Runtime registry: attributes are created in batches, one attribute
+   group (a subdirectory of /sys/class/x-class/registry) per batch.
+   echo "add NAME COUNT" > /sys/class/x-class/ctl  - NAME/v0..v<COUNT-1>
+   echo "del NAME" > /sys/class/x-class/ctl
+   cat /sys/class/x-class/ctl                      - batches and sizes */
+#define XXM_BATCH_MAX 10000
+#define XXM_NAME_LEN  16
 
-static OWN_CLASS_ATTR( data1 );
-static OWN_CLASS_ATTR( data2 );
-static OWN_CLASS_ATTR( data3 );
+struct xxm_dyn_attr {
+   struct device_attribute attr;
+   struct xxm_value *val;
+   char name[ XXM_NAME_LEN ];
+};
 
+struct xxm_batch {
+   struct list_head list;
+   struct attribute_group group;
+   unsigned int count;
+   struct xxm_dyn_attr *attrs;
+   struct attribute **ptrs;        /* NULL terminated, for the group */
+   char name[ XXM_NAME_LEN ];
+};
+
+static LIST_HEAD( xxm_batches );
+static DEFINE_MUTEX( xxm_lock );
 static struct class *x_class;
+static struct device *xxm_dev;
 
-int __init x_init(void) {
+static ssize_t xxm_dyn_show( struct device *dev, struct device_attribute *attr,
+                             char *buf ) {
+   return xxm_value_show( container_of( attr, struct xxm_dyn_attr, attr )->val, buf );
+}
+
+static ssize_t xxm_dyn_store( struct device *dev, struct device_attribute *attr,
+                              const char *buf, size_t count ) {
+   return xxm_value_store( container_of( attr, struct xxm_dyn_attr, attr )->val,
+                           buf, count );
+}
+
+static void xxm_batch_free( struct xxm_batch *b ) {
+   unsigned int i;
+   for( i = 0; i < b->count; i++ )
+      if( b->attrs[ i ].val )
+         kmem_cache_free( xxm_cache, b->attrs[ i ].val );
+   kvfree( b->attrs );
+   kvfree( b->ptrs );
+   kfree( b );
+}
+
+static struct xxm_batch *xxm_batch_find( const char *name ) {
+   struct xxm_batch *b;
+   list_for_each_entry( b, &xxm_batches, list )
+      if( 0 == strcmp( b->name, name ) )
+         return b;
+   return NULL;
+}
+
+static int xxm_batch_add( const char *name, unsigned int count ) {
+   struct xxm_batch *b;
+   unsigned int i;
    int res;
+   if( 0 == count || count > XXM_BATCH_MAX || strlen( name ) >= XXM_NAME_LEN )
+      return -EINVAL;
+   b = kzalloc( sizeof( *b ), GFP_KERNEL );
+   if( !b ) return -ENOMEM;
+   b->attrs = kvzalloc( count * sizeof( *b->attrs ), GFP_KERNEL );
+   b->ptrs = kvzalloc( ( count + 1 ) * sizeof( *b->ptrs ), GFP_KERNEL );
+   if( !b->attrs || !b->ptrs ) {
+      res = -ENOMEM;
+      goto err;
+   }
+   b->count = count;
+   strcpy( b->name, name );
+   for( i = 0; i < count; i++ ) {
+      struct xxm_dyn_attr *a = &b->attrs[ i ];
+      a->val = xxm_value_alloc( "" );
+      if( !a->val ) {
+         res = -ENOMEM;
+         goto err;
+      }
+      snprintf( a->name, sizeof( a->name ), "v%u", i );
+      sysfs_attr_init( &a->attr.attr );
+      a->attr.attr.name = a->name;
+      a->attr.attr.mode = S_IWUSR | S_IRUGO;
+      a->attr.show = xxm_dyn_show;
+      a->attr.store = xxm_dyn_store;
+      b->ptrs[ i ] = &a->attr.attr;
+   }
+   b->group.name = b->name;
+   b->group.attrs = b->ptrs;
+
+   mutex_lock( &xxm_lock );
+   if( xxm_batch_find( name ) )
+      res = -EEXIST;
+   else
+      res = sysfs_create_group( &xxm_dev->kobj, &b->group );
+   if( !res )
+      list_add_tail( &b->list, &xxm_batches );
+   mutex_unlock( &xxm_lock );
+   if( res ) goto err;
+   return 0;
+err:
+   xxm_batch_free( b );
+   return res;
+}
+
+static int xxm_batch_del( const char *name ) {
+   struct xxm_batch *b;
+   mutex_lock( &xxm_lock );
+   b = xxm_batch_find( name );
+   if( b ) {
+      list_del( &b->list );
+      /* returns after all running show()/store() of the group are done */
+      sysfs_remove_group( &xxm_dev->kobj, &b->group );
+   }
+   mutex_unlock( &xxm_lock );
+   if( !b ) return -ENOENT;
+   xxm_batch_free( b );
+   return 0;
+}
+
+static ssize_t ctl_show( struct class *class, struct class_attribute *attr,
+                         char *buf ) {
+   struct xxm_batch *b;
+   ssize_t len = 0;
+   mutex_lock( &xxm_lock );
+   list_for_each_entry( b, &xxm_batches, list )
+      len += scnprintf( buf + len, PAGE_SIZE - len, "%s %u\n", b->name, b->count );
+   mutex_unlock( &xxm_lock );
+   return len;
+}
+
+static ssize_t ctl_store( struct class *class, struct class_attribute *attr,
+                          const char *buf, size_t count ) {
+   // на символ больше допустимого: длинное имя видно, а не обрезано молча
+   char name[ XXM_NAME_LEN + 1 ];
+   unsigned int n;
+   int add, res;
+   if( 2 == sscanf( buf, "add %16s %u", name, &n ) ) add = 1;
+   else if( 1 == sscanf( buf, "del %16s", name ) ) add = 0;
+   else return -EINVAL;
+   // имя становится именем группы атрибутов - каталогом в sysfs
+   if( strlen( name ) >= XXM_NAME_LEN || strchr( name, '/' ) )
+      return -EINVAL;
+   res = add ? xxm_batch_add( name, n ) : xxm_batch_del( name );
+   return res ? res : count;
+}
+
+static CLASS_ATTR_RW( ctl );
+
+int __init x_init(void) {
+   int res, i;
+   xxm_cache = kmem_cache_create( "xxm_value", sizeof( struct xxm_value ), 0, 0, NULL );
+   if( !xxm_cache ) return -ENOMEM;
    x_class = class_create( THIS_MODULE, "x-class" );
-   if( IS_ERR( x_class ) ) printk( "bad class create\n" );
-   res = class_create_file( x_class, &class_attr_data1 );
-   res = class_create_file( x_class, &class_attr_data2 );
-   res = class_create_file( x_class, &class_attr_data3 );
+   if( IS_ERR( x_class ) ) {
+      printk( "bad class create\n" );
+      res = PTR_ERR( x_class );
+      goto err_class;
+   }
+   for( i = 0; i < ARRAY_SIZE( xxm_attrs ); i++ ) {
+      char init[ LEN_MSG + 1 ];
+      snprintf( init, sizeof( init ), "не инициализировано %s\n",
+                xxm_attrs[ i ].attr.attr.name );
+      xxm_attrs[ i ].val = xxm_value_alloc( init );
+      if( !xxm_attrs[ i ].val ) {
+         res = -ENOMEM;
+         goto err_attrs;
+      }
+      res = class_create_file( x_class, &xxm_attrs[ i ].attr );
+      if( res ) {
+         kmem_cache_free( xxm_cache, xxm_attrs[ i ].val );
+         goto err_attrs;
+      }
+   }
+   res = class_create_file( x_class, &class_attr_ctl );
+   if( res ) goto err_attrs;
+   xxm_dev = device_create( x_class, NULL, MKDEV( 0, 0 ), NULL, "registry" );
+   if( IS_ERR( xxm_dev ) ) {
+      res = PTR_ERR( xxm_dev );
+      goto err_dev;
+   }
    printk("'yxxx' module initialized\n");
    return 0;
+err_dev:
+   class_remove_file( x_class, &class_attr_ctl );
+err_attrs:
+   while( --i >= 0 ) {
+      class_remove_file( x_class, &xxm_attrs[ i ].attr );
+      kmem_cache_free( xxm_cache, xxm_attrs[ i ].val );
+   }
+   class_destroy( x_class );
+err_class:
+   kmem_cache_destroy( xxm_cache );
+   return res;
 }
 
 void x_cleanup(void) {
-   class_remove_file( x_class, &class_attr_data1 );
-   class_remove_file( x_class, &class_attr_data2 );
-   class_remove_file( x_class, &class_attr_data3 );
+   struct xxm_batch *b, *tmp;
+   int i;
+   class_remove_file( x_class, &class_attr_ctl );
+   list_for_each_entry_safe( b, tmp, &xxm_batches, list ) {
+      sysfs_remove_group( &xxm_dev->kobj, &b->group );
+      xxm_batch_free( b );
+   }
+   device_destroy( x_class, MKDEV( 0, 0 ) );
+   for( i = 0; i < ARRAY_SIZE( xxm_attrs ); i++ ) {
+      class_remove_file( x_class, &xxm_attrs[ i ].attr );
+      kmem_cache_free( xxm_cache, xxm_attrs[ i ].val );
+   }
    class_destroy( x_class );
+   kmem_cache_destroy( xxm_cache );
    return;
 }
 
 module_init( x_init );
 module_exit( x_cleanup );
 MODULE_LICENSE( "GPL" );
-
@@ -0,0 +1,109 @@
+/*
+ * Scaling of the xxm attribute registry.
+ *
+ * For 10, 100, 1000 and 10000 attributes: time to create the batch
+ * through the control attribute, time to open and read every attribute
+ * once, time of a second read on the open attribute (p50/p99), and time
+ * to remove the batch.
+ *
+ * usage: xxmbench [max attributes]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#define CLASS_DIR	"/sys/class/x-class"
+#define CTL		CLASS_DIR "/ctl"
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+static long long ctl(const char *fmt, const char *name, int count)
+{
+	char cmd[64];
+	long long t;
+	int fd, len;
+
+	len = snprintf(cmd, sizeof(cmd), fmt, name, count);
+	fd = open(CTL, O_WRONLY);
+	if (fd < 0) {
+		fprintf(stderr, "open %s: %m\n", CTL);
+		exit(EXIT_FAILURE);
+	}
+	t = now_ns();
+	if (write(fd, cmd, len) != len) {
+		fprintf(stderr, "'%s': %m\n", cmd);
+		exit(EXIT_FAILURE);
+	}
+	t = now_ns() - t;
+	close(fd);
+	return t;
+}
+
+
+static int cmp_ll(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+
+static void run(int count)
+{
+	long long *lat = malloc(count * sizeof(*lat));
+	long long t_add, t_open = 0, t_del, t;
+	char name[16], path[128], buf[256];
+	int i, fd;
+
+	snprintf(name, sizeof(name), "b%d", count);
+	t_add = ctl("add %s %d", name, count);
+
+	for (i = 0; i < count; i++) {
+		snprintf(path, sizeof(path), CLASS_DIR "/registry/%s/v%d",
+			 name, i);
+		t = now_ns();
+		fd = open(path, O_RDONLY);
+		if (fd < 0 || pread(fd, buf, sizeof(buf), 0) < 0) {
+			fprintf(stderr, "%s: %m\n", path);
+			exit(EXIT_FAILURE);
+		}
+		t_open += now_ns() - t;
+
+		/* Second read of an open attribute: show() only */
+		t = now_ns();
+		pread(fd, buf, sizeof(buf), 0);
+		lat[i] = now_ns() - t;
+		close(fd);
+	}
+	qsort(lat, count, sizeof(*lat), cmp_ll);
+
+	t_del = ctl("del %s", name, 0);
+
+	printf("%6d attrs: add %9.1f us (%6.0f ns/attr)  open+read %7.0f ns/attr"
+	       "  read p50 %5lld p99 %6lld ns  del %9.1f us\n", count,
+	       t_add / 1e3, (double)t_add / count, (double)t_open / count,
+	       lat[count / 2], lat[count * 99 / 100], t_del / 1e3);
+	free(lat);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int max = argc > 1 ? atoi(argv[1]) : 10000;
+	int n;
+
+	for (n = 10; n <= max; n *= 10)
+		run(n);
+
+	return EXIT_SUCCESS;
+}
@@ -5,9 +5,47 @@
 #include <linux/pci.h>
 #include <linux/version.h>
 #include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/rcupdate.h>
+#include <linux/spinlock.h>
+#include <linux/device.h>
+#include <linux/atomic.h>
 
 #define LEN_MSG 160
-static char buf_msg[ LEN_MSG + 1 ] = "Hello from module!\n";
+
+/* The message is never changed in place: store() publishes a new copy and
+   the old one is freed after a grace period, so show() needs no lock and
+   never sees a half written string */
+struct x_msg {
+   struct rcu_head rcu;
+   size_t len;
+   char data[];
+};
+
+static struct x_msg __rcu *x_msg;
+static DEFINE_SPINLOCK( x_msg_lock );   /* serializes writers only */
+
+/* Change notification. Class attributes can't be notified from a module
+   (the class kobject is private to the driver core), so the counter
+   lives on a "notify" device of the class:
+      fd = open( "/sys/class/x-class/notify/generation", O_RDONLY );
+      read( fd, ... );                  - arm: read once after open
+      poll( { fd, POLLPRI | POLLERR } ) - sleeps until the next store()
+      lseek( fd, 0, SEEK_SET ); read( fd, ... ); then read xxx
+   The wakeup only says "something changed": several stores may be
+   merged into one wakeup, the counter tells how many there were */
+static atomic_t x_gen = ATOMIC_INIT( 0 );
+static struct device *x_dev;
+
+static struct x_msg *x_msg_alloc( const char *buf, size_t len ) {
+   struct x_msg *msg = kmalloc( sizeof( *msg ) + len + 1, GFP_KERNEL );
+   if( msg ) {
+      memcpy( msg->data, buf, len );
+      msg->data[ len ] = '\0';
+      msg->len = len;
+   }
+   return msg;
+}
 
 /* <linux/device.h>
 LINUX_VERSION_CODE > KERNEL_VERSION(2,6,32)
@@ -31,9 +69,15 @@ static ssize_t xxx_show( struct class *class, struct class_attribute *attr, char
 #else
 static ssize_t x_show( struct class *class, char *buf ) {
 #endif
-   strcpy( buf, buf_msg );
-   printk( "read %ld\n", (long)strlen( buf ) );
-   return strlen( buf );
+   struct x_msg *msg;
+   size_t len;
+   rcu_read_lock();
+   msg = rcu_dereference( x_msg );
+   len = msg->len;
+   memcpy( buf, msg->data, len );
+   rcu_read_unlock();
+   pr_debug( "read %ld\n", (long)len );
+   return len;
 }
 
 /* sysfs store() method. Calls the store() method corresponding to the individual sysfs file */
@@ -42,12 +86,27 @@ static ssize_t xxx_store( struct class *class, struct class_attribute *attr, con
 #else
 static ssize_t x_store( struct class *class, const char *buf, size_t count ) {
 #endif
-   printk( "write %ld\n", (long)count );
-   strncpy( buf_msg, buf, count );
-   buf_msg[ count ] = '\0';
+   struct x_msg *msg, *old;
+   pr_debug( "write %ld\n", (long)count );
+   msg = x_msg_alloc( buf, min_t( size_t, count, LEN_MSG ) );
+   if( !msg ) return -ENOMEM;
+   spin_lock( &x_msg_lock );
+   old = rcu_dereference_protected( x_msg, lockdep_is_held( &x_msg_lock ) );
+   rcu_assign_pointer( x_msg, msg );
+   spin_unlock( &x_msg_lock );
+   kfree_rcu( old, rcu );
+   atomic_inc( &x_gen );
+   sysfs_notify( &x_dev->kobj, NULL, "generation" );
    return count;
 }
 
+static ssize_t generation_show( struct device *dev, struct device_attribute *attr,
+                                char *buf ) {
+   return sprintf( buf, "%u\n", (unsigned)atomic_read( &x_gen ) );
+}
+
+static DEVICE_ATTR_RO( generation );
+
 /* <linux/device.h>
 #define CLASS_ATTR(_name, _mode, _show, _store) \
 struct class_attribute class_attr_##_name = __ATTR(_name, _mode, _show, _store) */
@@ -57,12 +116,35 @@ static struct class *x_class;
 
 int __init x_init(void) {
    int res;
+   RCU_INIT_POINTER( x_msg, x_msg_alloc( "Hello from module!\n", 19 ) );
+   if( !rcu_access_pointer( x_msg ) ) return -ENOMEM;
    x_class = class_create( THIS_MODULE, "x-class" );
-   if( IS_ERR( x_class ) ) printk( "bad class create\n" );
+   if( IS_ERR( x_class ) ) {
+      printk( "bad class create\n" );
+      kfree( rcu_dereference_protected( x_msg, 1 ) );
+      return PTR_ERR( x_class );
+   }
+   /* the store() notifies through x_dev, so it must exist before xxx */
+   x_dev = device_create( x_class, NULL, MKDEV( 0, 0 ), NULL, "notify" );
+   if( IS_ERR( x_dev ) ) {
+      res = PTR_ERR( x_dev );
+      goto err_dev;
+   }
+   res = device_create_file( x_dev, &dev_attr_generation );
+   if( res ) goto err_gen;
    res = class_create_file( x_class, &class_attr_xxx );
 /* <linux/device.h>
 extern int __must_check class_create_file(struct class *class, const struct class_attribute *attr); */
+   if( res ) goto err_xxx;
    printk( "'xxx' module initialized\n" );
+   return 0;
+err_xxx:
+   device_remove_file( x_dev, &dev_attr_generation );
+err_gen:
+   device_destroy( x_class, MKDEV( 0, 0 ) );
+err_dev:
+   class_destroy( x_class );
+   kfree( rcu_dereference_protected( x_msg, 1 ) );
    return res;
 }
 
@@ -70,7 +152,10 @@ void x_cleanup(void) {
 /* <linux/device.h>
 extern void class_remove_file(struct class *class, const struct class_attribute *attr); */
    class_remove_file( x_class, &class_attr_xxx );
+   device_remove_file( x_dev, &dev_attr_generation );
+   device_destroy( x_class, MKDEV( 0, 0 ) );
    class_destroy( x_class );
+   kfree( rcu_dereference_protected( x_msg, 1 ) );
    return;
 }
 
@@ -0,0 +1,170 @@
+/*
+ * Concurrent readers/writers for the 'xxx' class attribute.
+ *
+ * Writers store messages made of one repeated character, readers check
+ * that every message they get is uniform (a torn read mixes characters
+ * or has the wrong length). Read throughput is measured for 1, 2, 4, ...
+ * reader threads up to the number of CPUs.
+ *
+ * usage: xxxstress [-f path] [-w writers] [-d seconds per step]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+
+#define LEN_MSG	160
+
+static const char *path = "/sys/class/x-class/xxx";
+static volatile int stop;
+
+struct worker {
+	pthread_t tid;
+	int id;
+	long long ops;
+	long long torn;
+};
+
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static int open_attr(int flags)
+{
+	int fd = open(path, flags);
+
+	if (fd < 0) {
+		fprintf(stderr, "open %s: %m\n", path);
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+
+static void *reader(void *arg)
+{
+	struct worker *w = arg;
+	char buf[4096];
+	int fd = open_attr(O_RDONLY);
+	ssize_t len, i;
+
+	while (!stop) {
+		/* sysfs calls show() again for every read from offset 0 */
+		len = pread(fd, buf, sizeof(buf), 0);
+		if (len <= 0) {
+			perror("pread");
+			exit(EXIT_FAILURE);
+		}
+		w->ops++;
+
+		/* Written messages are "ccc...c\n", length encodes the char */
+		if (len > 5 && memcmp(buf, "Hello", 5) == 0)
+			continue;	/* the initial message */
+		for (i = 1; i < len - 1; i++)
+			if (buf[i] != buf[0])
+				break;
+		if (buf[len - 1] != '\n' || i != len - 1 ||
+		    len - 1 != (buf[0] - 'A') % 40 * 4 + 1)
+			w->torn++;
+	}
+	close(fd);
+	return NULL;
+}
+
+
+static void *writer(void *arg)
+{
+	struct worker *w = arg;
+	char buf[LEN_MSG];
+	int fd = open_attr(O_WRONLY);
+	int c, len;
+
+	while (!stop) {
+		c = (w->ops + w->id) % 40;
+		len = c * 4 + 1;
+		memset(buf, 'A' + c, len);
+		buf[len] = '\n';
+		if (pwrite(fd, buf, len + 1, 0) != len + 1) {
+			perror("pwrite");
+			exit(EXIT_FAILURE);
+		}
+		w->ops++;
+	}
+	close(fd);
+	return NULL;
+}
+
+
+static void run(int readers, int writers, int seconds)
+{
+	struct worker *w = calloc(readers + writers, sizeof(*w));
+	long long reads = 0, writes = 0, torn = 0;
+	double t;
+	int i;
+
+	stop = 0;
+	t = now();
+	for (i = 0; i < readers + writers; i++) {
+		w[i].id = i;
+		pthread_create(&w[i].tid, NULL, i < readers ? reader : writer,
+			       &w[i]);
+	}
+	sleep(seconds);
+	stop = 1;
+	for (i = 0; i < readers + writers; i++) {
+		pthread_join(w[i].tid, NULL);
+		if (i < readers)
+			reads += w[i].ops;
+		else
+			writes += w[i].ops;
+		torn += w[i].torn;
+	}
+	t = now() - t;
+
+	printf("%3d readers %2d writers: %10.0f reads/s %9.0f per reader"
+	       " %9.0f writes/s  torn %lld\n", readers, writers, reads / t,
+	       reads / t / readers, writes / t, torn);
+	free(w);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int writers = 1, seconds = 2;
+	int opt, n;
+
+	while ((opt = getopt(argc, argv, "f:w:d:")) != -1) {
+		switch (opt) {
+		case 'f':
+			path = optarg;
+			break;
+		case 'w':
+			writers = atoi(optarg);
+			break;
+		case 'd':
+			seconds = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-f path] [-w writers]"
+				" [-d seconds]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (n = 1; n <= cpus; n *= 2)
+		run(n, writers, seconds);
+	if (n / 2 != cpus)
+		run(cpus, writers, seconds);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+/*
+ * Store-to-wakeup latency of the 'xxx' change notification.
+ *
+ * A writer thread stores "seq N" into xxx every interval. A watcher
+ * thread notices the change either by poll()ing the generation counter
+ * (POLLPRI, woken by sysfs_notify()) or by re-reading xxx in a tight
+ * loop. Both modes report the latency from the start of the store to the
+ * watcher seeing it, and the CPU time the watcher burned.
+ *
+ * usage: xxxwatch [-i interval us] [-d seconds per mode]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#define XXX_PATH	"/sys/class/x-class/xxx"
+#define GEN_PATH	"/sys/class/x-class/notify/generation"
+#define MAX_STORES	(1 << 20)
+
+static long long *t_store;	/* start of the N-th store */
+static volatile int stores;
+static volatile int stop;
+static int interval_us = 1000;
+
+static long long *lat;
+static int nlat;
+
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+static int open_or_die(const char *path, int flags)
+{
+	int fd = open(path, flags);
+
+	if (fd < 0) {
+		fprintf(stderr, "open %s: %m\n", path);
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+
+static void *writer(void *arg)
+{
+	int fd = open_or_die(XXX_PATH, O_WRONLY);
+	char buf[32];
+	int len;
+
+	while (!stop && stores < MAX_STORES) {
+		len = sprintf(buf, "seq %d\n", stores);
+		t_store[stores] = now_ns();
+		__sync_synchronize();
+		if (pwrite(fd, buf, len, 0) != len) {
+			perror("store");
+			exit(EXIT_FAILURE);
+		}
+		stores++;
+		usleep(interval_us);
+	}
+	close(fd);
+	return NULL;
+}
+
+
+static void record(int seq, long long t)
+{
+	if (seq >= 0 && seq < stores + 1 && nlat < MAX_STORES)
+		lat[nlat++] = t - t_store[seq];
+}
+
+
+static unsigned int read_gen(int fd)
+{
+	char buf[32];
+	ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+
+	if (len <= 0) {
+		perror("generation");
+		exit(EXIT_FAILURE);
+	}
+	buf[len] = '\0';
+	return strtoul(buf, NULL, 10);
+}
+
+
+/* Sleep in poll(), the generation tells which store woke us up */
+static void *watch_poll(void *arg)
+{
+	int fd = open_or_die(GEN_PATH, O_RDONLY);
+	struct pollfd pfd = { .fd = fd, .events = POLLPRI | POLLERR };
+	unsigned int gen0 = read_gen(fd), gen;
+	long long t;
+
+	while (!stop) {
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+		t = now_ns();
+		/* reading again re-arms the notification */
+		gen = read_gen(fd);
+		record(gen - gen0 - 1, t);
+	}
+	close(fd);
+	return NULL;
+}
+
+
+/* Re-read the value until it changes */
+static void *watch_spin(void *arg)
+{
+	int fd = open_or_die(XXX_PATH, O_RDONLY);
+	char buf[256], last[256] = "";
+	long long t;
+	ssize_t len;
+	int seq;
+
+	while (!stop) {
+		len = pread(fd, buf, sizeof(buf) - 1, 0);
+		t = now_ns();
+		if (len <= 0) {
+			perror("xxx");
+			exit(EXIT_FAILURE);
+		}
+		buf[len] = '\0';
+		if (strcmp(buf, last) == 0)
+			continue;
+		strcpy(last, buf);
+		if (sscanf(buf, "seq %d", &seq) == 1)
+			record(seq, t);
+	}
+	close(fd);
+	return NULL;
+}
+
+
+static int cmp_ll(const void *a, const void *b)
+{
+	long long x = *(const long long *)a, y = *(const long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+
+static void *watch_thread(void *arg)
+{
+	void *(*watch)(void *) = arg;
+	struct rusage ru;
+	double *cpu = malloc(sizeof(*cpu));
+
+	watch(NULL);
+	getrusage(RUSAGE_THREAD, &ru);
+	*cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+	       ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+	return cpu;
+}
+
+
+static void run(const char *name, void *(*watch)(void *), int seconds)
+{
+	pthread_t w, r;
+	long long t;
+	double *cpu;
+
+	stores = 0;
+	nlat = 0;
+	stop = 0;
+	t = now_ns();
+	pthread_create(&r, NULL, watch_thread, watch);
+	usleep(10000);	/* let the watcher arm itself */
+	pthread_create(&w, NULL, writer, NULL);
+	sleep(seconds);
+	stop = 1;
+	pthread_join(w, NULL);
+	pthread_join(r, (void **)&cpu);
+	t = now_ns() - t;
+
+	qsort(lat, nlat, sizeof(*lat), cmp_ll);
+	printf("%-5s %6d stores %6d seen  latency p50 %7.1f p99 %8.1f us"
+	       "  watcher CPU %5.1f%%\n", name, stores, nlat,
+	       nlat ? lat[nlat / 2] / 1e3 : 0, nlat ? lat[nlat * 99 / 100] / 1e3 : 0,
+	       *cpu * 1e9 / t * 100);
+	free(cpu);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int seconds = 3;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "i:d:")) != -1) {
+		switch (opt) {
+		case 'i':
+			interval_us = atoi(optarg);
+			break;
+		case 'd':
+			seconds = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-i interval us] [-d seconds]\n",
+				argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	t_store = calloc(MAX_STORES, sizeof(*t_store));
+	lat = calloc(MAX_STORES, sizeof(*lat));
+
+	run("poll", watch_poll, seconds);
+	run("spin", watch_spin, seconds);
+
+	return EXIT_SUCCESS;
+}
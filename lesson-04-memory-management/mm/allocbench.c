@@ -0,0 +1,453 @@
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/slab.h>
+#include <linux/mempool.h>
+#include <linux/percpu.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+
+/*
+ * Allocator micro-benchmark.
+ *
+ * Configure through /sys/kernel/allocbench/{allocator,size,batch,threads,
+ * iterations}, then write anything to 'run'. Every thread allocates
+ * 'batch' objects, writes to each of them and frees them again, until it
+ * has done 'iterations' allocations. The run is repeated with 1, 2, 4, ...
+ * up to 'threads' threads, each bound to its own CPU, and 'results' shows
+ * ns per allocation+free pair and the total rate for every thread count.
+ *
+ * allocators: kmalloc, kmem_cache, mempool, percpu, page_frag
+ */
+
+enum {
+	AB_KMALLOC,
+	AB_CACHE,
+	AB_MEMPOOL,
+	AB_PERCPU,
+	AB_PAGE_FRAG,
+	AB_NUM,
+};
+
+static const char * const ab_names[AB_NUM] = {
+	[AB_KMALLOC]	= "kmalloc",
+	[AB_CACHE]	= "kmem_cache",
+	[AB_MEMPOOL]	= "mempool",
+	[AB_PERCPU]	= "percpu",
+	[AB_PAGE_FRAG]	= "page_frag",
+};
+
+static int ab_alloc = AB_KMALLOC;
+static unsigned int ab_size = 64;
+static unsigned int ab_batch = 16;
+static unsigned int ab_threads = 1;
+static unsigned int ab_iterations = 1000000;
+
+#define AB_BATCH_MAX	4096
+#define AB_RESULTS_LEN	PAGE_SIZE
+#define AB_POOL_BYTES	(4 << 20)	/* mempool reserve limit */
+
+static DEFINE_MUTEX(ab_lock);	/* configuration, runs and results */
+static char *ab_results;
+
+/* Shared objects of one run */
+static struct kmem_cache *ab_cache;
+static mempool_t *ab_pool;
+
+
+/*
+ * Per-CPU object cache on top of ab_cache: a small stack of free objects
+ * per CPU, refilled and drained in bulk, so most operations touch only
+ * CPU local data.
+ */
+#define PCP_OBJS	64
+
+struct ab_pcp {
+	unsigned int nr;
+	void *objs[PCP_OBJS];
+};
+
+static struct ab_pcp __percpu *ab_pcp;
+
+
+static void *pcp_alloc(void)
+{
+	struct ab_pcp *pcp = get_cpu_ptr(ab_pcp);
+	void *obj = NULL;
+
+	if (pcp->nr == 0)
+		pcp->nr = kmem_cache_alloc_bulk(ab_cache, GFP_ATOMIC,
+						PCP_OBJS / 2, pcp->objs);
+	if (pcp->nr)
+		obj = pcp->objs[--pcp->nr];
+	put_cpu_ptr(ab_pcp);
+	return obj;
+}
+
+
+static void pcp_free(void *obj)
+{
+	struct ab_pcp *pcp = get_cpu_ptr(ab_pcp);
+
+	if (pcp->nr == PCP_OBJS) {
+		kmem_cache_free_bulk(ab_cache, PCP_OBJS / 2,
+				     &pcp->objs[PCP_OBJS / 2]);
+		pcp->nr = PCP_OBJS / 2;
+	}
+	pcp->objs[pcp->nr++] = obj;
+	put_cpu_ptr(ab_pcp);
+}
+
+
+static void pcp_drain(void)
+{
+	struct ab_pcp *pcp;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		pcp = per_cpu_ptr(ab_pcp, cpu);
+		kmem_cache_free_bulk(ab_cache, pcp->nr, pcp->objs);
+		pcp->nr = 0;
+	}
+}
+
+
+struct ab_thread {
+	struct completion done;
+	u64 ns;
+	int err;
+};
+
+
+static int ab_thread_fn(void *arg)
+{
+	struct ab_thread *t = arg;
+	struct page_frag_cache frag = {};
+	unsigned int batch = ab_batch;
+	unsigned int done, i;
+	void **objs;
+	u64 start;
+
+	objs = kmalloc_array(batch, sizeof(*objs), GFP_KERNEL);
+	if (!objs) {
+		t->err = -ENOMEM;
+		complete_and_exit(&t->done, 0);
+	}
+
+	start = ktime_get_ns();
+	for (done = 0; done < ab_iterations && !t->err; done += batch) {
+		for (i = 0; i < batch; i++) {
+			switch (ab_alloc) {
+			case AB_KMALLOC:
+				objs[i] = kmalloc(ab_size, GFP_KERNEL);
+				break;
+			case AB_CACHE:
+				objs[i] = kmem_cache_alloc(ab_cache, GFP_KERNEL);
+				break;
+			case AB_MEMPOOL:
+				objs[i] = mempool_alloc(ab_pool, GFP_KERNEL);
+				break;
+			case AB_PERCPU:
+				objs[i] = pcp_alloc();
+				break;
+			case AB_PAGE_FRAG:
+				objs[i] = page_frag_alloc(&frag, ab_size, GFP_KERNEL);
+				break;
+			}
+			if (!objs[i]) {
+				t->err = -ENOMEM;
+				break;
+			}
+			/* Touch the object like a real user would */
+			*(volatile char *)objs[i] = 0;
+		}
+
+		while (i--) {
+			switch (ab_alloc) {
+			case AB_KMALLOC:
+				kfree(objs[i]);
+				break;
+			case AB_CACHE:
+				kmem_cache_free(ab_cache, objs[i]);
+				break;
+			case AB_MEMPOOL:
+				mempool_free(objs[i], ab_pool);
+				break;
+			case AB_PERCPU:
+				pcp_free(objs[i]);
+				break;
+			case AB_PAGE_FRAG:
+				page_frag_free(objs[i]);
+				break;
+			}
+		}
+		cond_resched();
+	}
+	t->ns = ktime_get_ns() - start;
+
+	if (frag.va)
+		__page_frag_cache_drain(virt_to_head_page(frag.va),
+					frag.pagecnt_bias);
+	kfree(objs);
+	complete_and_exit(&t->done, 0);
+}
+
+
+/* One run with nr threads on the first nr online CPUs */
+static int ab_run_threads(unsigned int nr, char *buf, size_t size)
+{
+	struct ab_thread *threads;
+	struct task_struct *task;
+	unsigned int i, started = 0;
+	u64 ns = 0, ops;
+	int cpu, err = 0;
+
+	threads = kcalloc(nr, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	cpu = cpumask_first(cpu_online_mask);
+	for (i = 0; i < nr; i++) {
+		init_completion(&threads[i].done);
+		task = kthread_create_on_node(ab_thread_fn, &threads[i],
+					      cpu_to_node(cpu), "allocbench/%u", i);
+		if (IS_ERR(task)) {
+			err = PTR_ERR(task);
+			break;
+		}
+		kthread_bind(task, cpu);
+		wake_up_process(task);
+		started++;
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+	}
+
+	for (i = 0; i < started; i++) {
+		wait_for_completion(&threads[i].done);
+		if (threads[i].err)
+			err = threads[i].err;
+		ns += threads[i].ns;
+	}
+	kfree(threads);
+	if (err)
+		return err;
+
+	/* Allocations actually done, rounded up to whole batches */
+	ops = (u64)DIV_ROUND_UP(ab_iterations, ab_batch) * ab_batch;
+	scnprintf(buf, size, "%-10s size %5u batch %4u threads %3u: "
+		  "%6llu ns/op %10llu ops/s\n", ab_names[ab_alloc], ab_size,
+		  ab_batch, nr, div64_u64(ns, ops * nr),
+		  div64_u64(ops * nr * NSEC_PER_SEC, div64_u64(ns, nr) ?: 1));
+	return 0;
+}
+
+
+/*
+ * The mempool reserve is only the fallback for a failing kmem_cache_alloc,
+ * it need not cover every object in flight: batch * threads * size could
+ * pin gigabytes. It is capped at AB_POOL_BYTES and only set up for runs
+ * that use it.
+ */
+static int ab_setup(void)
+{
+	unsigned int min_nr;
+
+	if (ab_alloc == AB_PAGE_FRAG && ab_size > PAGE_SIZE)
+		return -EINVAL;
+
+	ab_cache = kmem_cache_create("allocbench", ab_size, 0, 0, NULL);
+	if (!ab_cache)
+		return -ENOMEM;
+	if (ab_alloc == AB_MEMPOOL) {
+		min_nr = min_t(u64, (u64)ab_batch * ab_threads,
+			       max(AB_POOL_BYTES / ab_size, 1U));
+		ab_pool = mempool_create_slab_pool(min_nr, ab_cache);
+		if (!ab_pool)
+			return -ENOMEM;
+	}
+	ab_pcp = alloc_percpu(struct ab_pcp);
+	if (!ab_pcp)
+		return -ENOMEM;
+	return 0;
+}
+
+
+static void ab_teardown(void)
+{
+	if (ab_pcp) {
+		pcp_drain();
+		free_percpu(ab_pcp);
+		ab_pcp = NULL;
+	}
+	if (ab_pool) {
+		mempool_destroy(ab_pool);
+		ab_pool = NULL;
+	}
+	kmem_cache_destroy(ab_cache);
+	ab_cache = NULL;
+}
+
+
+static int ab_run(void)
+{
+	size_t len = 0;
+	unsigned int nr;
+	int err;
+
+	ab_results[0] = '\0';
+	err = ab_setup();
+	for (nr = 1; !err; nr = min(nr * 2, ab_threads)) {
+		err = ab_run_threads(nr, ab_results + len, AB_RESULTS_LEN - len);
+		len += strlen(ab_results + len);
+		if (nr == ab_threads)
+			break;
+	}
+	ab_teardown();
+	return err;
+}
+
+
+static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
+			 const char *buf, size_t count)
+{
+	int err;
+
+	mutex_lock(&ab_lock);
+	err = ab_run();
+	mutex_unlock(&ab_lock);
+	return err ? err : count;
+}
+
+
+static ssize_t results_show(struct kobject *kobj, struct kobj_attribute *attr,
+			    char *buf)
+{
+	ssize_t len;
+
+	mutex_lock(&ab_lock);
+	len = scnprintf(buf, PAGE_SIZE, "%s", ab_results);
+	mutex_unlock(&ab_lock);
+	return len;
+}
+
+
+static ssize_t allocator_show(struct kobject *kobj, struct kobj_attribute *attr,
+			      char *buf)
+{
+	return sprintf(buf, "%s\n", ab_names[ab_alloc]);
+}
+
+
+static ssize_t allocator_store(struct kobject *kobj, struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	int i = sysfs_match_string(ab_names, buf);
+
+	if (i < 0)
+		return i;
+	mutex_lock(&ab_lock);
+	ab_alloc = i;
+	mutex_unlock(&ab_lock);
+	return count;
+}
+
+
+/* Numeric parameters, all unsigned int with a range */
+#define AB_UINT_ATTR(_name, _min, _max)					\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%u\n", ab_##_name);			\
+}									\
+static ssize_t _name##_store(struct kobject *kobj,			\
+			     struct kobj_attribute *attr,		\
+			     const char *buf, size_t count)		\
+{									\
+	unsigned int val;						\
+	int err = kstrtouint(buf, 0, &val);				\
+									\
+	if (err)							\
+		return err;						\
+	if (val < (_min) || val > (_max))				\
+		return -ERANGE;						\
+	mutex_lock(&ab_lock);						\
+	ab_##_name = val;						\
+	mutex_unlock(&ab_lock);						\
+	return count;							\
+}									\
+static struct kobj_attribute _name##_attr = __ATTR_RW(_name)
+
+AB_UINT_ATTR(size, 1, KMALLOC_MAX_CACHE_SIZE);
+AB_UINT_ATTR(batch, 1, AB_BATCH_MAX);
+AB_UINT_ATTR(threads, 1, 1024);
+AB_UINT_ATTR(iterations, 1, INT_MAX);
+
+static struct kobj_attribute allocator_attr = __ATTR_RW(allocator);
+static struct kobj_attribute run_attr = __ATTR_WO(run);
+static struct kobj_attribute results_attr = __ATTR_RO(results);
+
+static struct attribute *ab_attrs[] = {
+	&allocator_attr.attr,
+	&size_attr.attr,
+	&batch_attr.attr,
+	&threads_attr.attr,
+	&iterations_attr.attr,
+	&run_attr.attr,
+	&results_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group ab_group = {
+	.attrs = ab_attrs,
+};
+
+static struct kobject *ab_kobj;
+
+
+static int __init ab_init(void)
+{
+	int err;
+
+	ab_results = kzalloc(AB_RESULTS_LEN, GFP_KERNEL);
+	if (!ab_results)
+		return -ENOMEM;
+
+	ab_kobj = kobject_create_and_add("allocbench", kernel_kobj);
+	if (!ab_kobj) {
+		err = -ENOMEM;
+		goto err_kobj;
+	}
+	err = sysfs_create_group(ab_kobj, &ab_group);
+	if (err)
+		goto err_group;
+
+	pr_info("allocbench: /sys/kernel/allocbench ready\n");
+	return 0;
+
+err_group:
+	kobject_put(ab_kobj);
+err_kobj:
+	kfree(ab_results);
+	return err;
+}
+
+
+static void __exit ab_exit(void)
+{
+	sysfs_remove_group(ab_kobj, &ab_group);
+	kobject_put(ab_kobj);
+	kfree(ab_results);
+}
+
+module_init(ab_init);
+module_exit(ab_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("kmalloc/kmem_cache/mempool/per-CPU/page_frag benchmark");
@@ -0,0 +1,143 @@
+/*
+ * Large message blob: chunked read()/write() versus mmap().
+ *
+ * Writes and reads back the whole /sys/class/x-class/blob/data with
+ * pread()/pwrite() of different chunk sizes, then does the same through a
+ * shared mapping, and reports MB/s for each.
+ *
+ * kernfs moves at most a page per read()/write() of a binary attribute,
+ * so chunks above PAGE_SIZE are split into several calls. They show that
+ * a bigger user buffer does not save syscalls here.
+ *
+ * usage: blobbench [passes]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BLOB_PATH	"/sys/class/x-class/blob/data"
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void report(const char *what, size_t chunk, size_t bytes,
+		   double t_write, double t_read)
+{
+	printf("%-6s chunk %8zu: write %8.1f MB/s  read %8.1f MB/s\n",
+	       what, chunk, bytes / t_write / 1e6, bytes / t_read / 1e6);
+}
+
+
+/* pwrite()/pread() of all len bytes, looping over short transfers */
+static void xfer(int fd, char *buf, size_t len, off_t off, int write)
+{
+	ssize_t n;
+
+	while (len) {
+		n = write ? pwrite(fd, buf, len, off) : pread(fd, buf, len, off);
+		if (n <= 0) {
+			perror(write ? "pwrite" : "pread");
+			exit(EXIT_FAILURE);
+		}
+		buf += n;
+		off += n;
+		len -= n;
+	}
+}
+
+
+static void bench_rw(int fd, char *buf, size_t size, size_t chunk, int passes)
+{
+	double t, t_write, t_read;
+	size_t off, len;
+	int i;
+
+	t = now();
+	for (i = 0; i < passes; i++)
+		for (off = 0; off < size; off += len) {
+			len = size - off < chunk ? size - off : chunk;
+			xfer(fd, buf + off, len, off, 1);
+		}
+	t_write = now() - t;
+
+	t = now();
+	for (i = 0; i < passes; i++)
+		for (off = 0; off < size; off += len) {
+			len = size - off < chunk ? size - off : chunk;
+			xfer(fd, buf + off, len, off, 0);
+		}
+	t_read = now() - t;
+
+	report("rw", chunk, size * passes, t_write, t_read);
+}
+
+
+static void bench_mmap(int fd, char *buf, size_t size, int passes)
+{
+	double t, t_write, t_read;
+	char *map;
+	int i;
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		exit(EXIT_FAILURE);
+	}
+
+	t = now();
+	for (i = 0; i < passes; i++)
+		memcpy(map, buf, size);
+	t_write = now() - t;
+
+	t = now();
+	for (i = 0; i < passes; i++)
+		memcpy(buf, map, size);
+	t_read = now() - t;
+
+	report("mmap", size, size * passes, t_write, t_read);
+	munmap(map, size);
+}
+
+
+int main(int argc, char *argv[])
+{
+	size_t chunks[] = { 160, 4096, 65536, 1 << 20 };
+	int passes = argc > 1 ? atoi(argv[1]) : 10;
+	struct stat st;
+	size_t size, i;
+	char *buf;
+	int fd;
+
+	fd = open(BLOB_PATH, O_RDWR);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "%s: %m\n", BLOB_PATH);
+		return EXIT_FAILURE;
+	}
+	size = st.st_size;
+	buf = malloc(size);
+	if (!buf) {
+		perror("malloc");
+		return EXIT_FAILURE;
+	}
+	memset(buf, 'x', size);
+	printf("%s: %zu bytes, %d passes\n", BLOB_PATH, size, passes);
+
+	for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+		bench_rw(fd, buf, size, chunks[i], passes);
+	bench_mmap(fd, buf, size, passes);
+
+	close(fd);
+	free(buf);
+	return EXIT_SUCCESS;
+}
@@ -5,48 +5,386 @@
 #include <linux/pci.h>
 #include <linux/version.h>
 #include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/rcupdate.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
+#include <linux/ktime.h>
+#include <linux/shrinker.h>
+#include <linux/vmalloc.h>
+#include <linux/device.h>
+#include <linux/rwsem.h>
+#include <linux/mm.h>
 
 #define LEN_MSG 160
-static char buf_msg[LEN_MSG + 1] = "Hello from module!\n";
+
+static unsigned int max_entries = 4096;
+module_param(max_entries, uint, 0644);
+MODULE_PARM_DESC(max_entries, "log length limit, oldest entries are dropped");
+
+/*
+ * Every store appends an entry to the log, entries come from their own
+ * kmem_cache. The log is bounded by max_entries and trimmed further by a
+ * shrinker under memory pressure, oldest entries first.
+ *
+ * The newest entry is also published through an RCU pointer, so xxx_show()
+ * takes no lock and never sees a half written string. Entries are freed
+ * after a grace period for that reason.
+ */
+struct x_entry {
+	struct list_head list;
+	struct rcu_head rcu;
+	u64 seq;
+	ktime_t time;
+	size_t len;
+	char data[LEN_MSG + 1];
+};
+
+static struct kmem_cache *x_cache;
+static LIST_HEAD(x_log);
+static DEFINE_SPINLOCK(x_log_lock);	/* the list and the counters */
+static struct x_entry __rcu *x_last;
+
+static unsigned long x_entries;
+static u64 x_appended;
+static unsigned long x_dropped_limit;
+static unsigned long x_dropped_shrink;
+
+
+static struct x_entry *x_entry_alloc(const char *buf, size_t len)
+{
+	struct x_entry *entry = kmem_cache_alloc(x_cache, GFP_KERNEL);
+
+	if (entry) {
+		memcpy(entry->data, buf, len);
+		entry->data[len] = '\0';
+		entry->len = len;
+		entry->time = ktime_get_real();
+	}
+	return entry;
+}
+
+
+static void x_entry_free_rcu(struct rcu_head *head)
+{
+	kmem_cache_free(x_cache, container_of(head, struct x_entry, rcu));
+}
+
+
+/* Drop up to nr oldest entries, keeping the newest one. Lock held. */
+static unsigned long x_log_trim(unsigned long nr)
+{
+	struct x_entry *entry;
+	unsigned long freed = 0;
+
+	while (freed < nr && x_entries > 1) {
+		entry = list_first_entry(&x_log, struct x_entry, list);
+		list_del(&entry->list);
+		x_entries--;
+		call_rcu(&entry->rcu, x_entry_free_rcu);
+		freed++;
+	}
+	return freed;
+}
+
+
+static void x_log_append(struct x_entry *entry)
+{
+	spin_lock(&x_log_lock);
+	entry->seq = x_appended++;
+	list_add_tail(&entry->list, &x_log);
+	x_entries++;
+	rcu_assign_pointer(x_last, entry);
+	if (x_entries > max_entries)
+		x_dropped_limit += x_log_trim(x_entries - max(max_entries, 1U));
+	spin_unlock(&x_log_lock);
+}
 
 
 static ssize_t xxx_show(struct class *class, struct class_attribute *attr,
 						char *buf)
 {
-	strcpy(buf, buf_msg);
-	pr_info("read %ld\n", (long)strlen(buf));
-	return strlen(buf);
+	struct x_entry *entry;
+	size_t len;
+
+	rcu_read_lock();
+	entry = rcu_dereference(x_last);
+	len = entry->len;
+	memcpy(buf, entry->data, len);
+	rcu_read_unlock();
+	pr_debug("read %ld\n", (long)len);
+	return len;
 }
 
 static ssize_t xxx_store(struct class *class, struct class_attribute *attr,
 						 const char *buf, size_t count)
 {
-	pr_info("write %ld\n", (long)count);
-	strncpy(buf_msg, buf, count);
-	buf_msg[count] = '\0';
+	struct x_entry *entry;
+
+	pr_debug("write %ld\n", (long)count);
+	entry = x_entry_alloc(buf, min_t(size_t, count, LEN_MSG));
+	if (!entry)
+		return -ENOMEM;
+
+	x_log_append(entry);
 	return count;
 }
 
 CLASS_ATTR_RW(xxx);
 
+
+/* As many of the newest entries as fit in a page, oldest first */
+static ssize_t xxx_log_show(struct class *class, struct class_attribute *attr,
+							char *buf)
+{
+	struct x_entry *entry;
+	struct timespec64 ts;
+	size_t need = 0;
+	ssize_t len = 0;
+
+	spin_lock(&x_log_lock);
+	/* Walk back to the oldest entry which still fits, ~40 for the prefix */
+	list_for_each_entry_reverse(entry, &x_log, list) {
+		need += entry->len + 40;
+		if (need >= PAGE_SIZE)
+			break;
+	}
+	list_for_each_entry_continue(entry, &x_log, list) {
+		ts = ktime_to_timespec64(entry->time);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%llu %lld.%06ld %s%s",
+				 entry->seq, (long long)ts.tv_sec,
+				 ts.tv_nsec / NSEC_PER_USEC, entry->data,
+				 entry->len && entry->data[entry->len - 1] == '\n' ?
+				 "" : "\n");
+	}
+	spin_unlock(&x_log_lock);
+	return len;
+}
+
+static struct class_attribute class_attr_xxx_log = __ATTR_RO(xxx_log);
+
+
+static ssize_t xxx_stats_show(struct class *class, struct class_attribute *attr,
+							  char *buf)
+{
+	unsigned int size = kmem_cache_size(x_cache);
+	ssize_t len;
+
+	spin_lock(&x_log_lock);
+	len = sprintf(buf,
+		      "entries %lu\nmax_entries %u\nobject_size %u\nslab_bytes %lu\n"
+		      "appended %llu\ndropped_limit %lu\ndropped_shrinker %lu\n",
+		      x_entries, max_entries, size, x_entries * size,
+		      x_appended, x_dropped_limit, x_dropped_shrink);
+	spin_unlock(&x_log_lock);
+	return len;
+}
+
+static struct class_attribute class_attr_xxx_stats = __ATTR_RO(xxx_stats);
+
+
+static unsigned long x_shrink_count(struct shrinker *s,
+				    struct shrink_control *sc)
+{
+	unsigned long nr = READ_ONCE(x_entries);
+
+	return nr > 1 ? nr - 1 : 0;
+}
+
+static unsigned long x_shrink_scan(struct shrinker *s,
+				   struct shrink_control *sc)
+{
+	unsigned long freed;
+
+	spin_lock(&x_log_lock);
+	freed = x_log_trim(sc->nr_to_scan);
+	x_dropped_shrink += freed;
+	spin_unlock(&x_log_lock);
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker x_shrinker = {
+	.count_objects = x_shrink_count,
+	.scan_objects = x_shrink_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
+
+/*
+ * Large messages don't fit in a text attribute (one page at most), they go
+ * to a vmalloc'ed blob exposed as a binary attribute of the "blob" device:
+ * /sys/class/x-class/blob/data. read()/write() take any offset, but kernfs
+ * passes at most PAGE_SIZE bytes per call, so larger transfers return
+ * short counts and must be looped. The blob can also be mmap()ed shared
+ * and updated in place. Only read() and write() are serialized with each
+ * other, mapping users must agree on their own protocol.
+ */
 static struct class *x_class;
 
+static unsigned long blob_size = 4 << 20;
+module_param(blob_size, ulong, 0444);
+MODULE_PARM_DESC(blob_size, "large message blob size in bytes, 0 disables it");
+
+static void *x_blob;
+static DECLARE_RWSEM(x_blob_lock);
+static struct device *x_blob_dev;
+
+
+static ssize_t x_blob_read(struct file *file, struct kobject *kobj,
+			   struct bin_attribute *attr, char *buf,
+			   loff_t off, size_t count)
+{
+	/* sysfs already clipped off + count to attr->size */
+	down_read(&x_blob_lock);
+	memcpy(buf, x_blob + off, count);
+	up_read(&x_blob_lock);
+	return count;
+}
+
+static ssize_t x_blob_write(struct file *file, struct kobject *kobj,
+			    struct bin_attribute *attr, char *buf,
+			    loff_t off, size_t count)
+{
+	down_write(&x_blob_lock);
+	memcpy(x_blob + off, buf, count);
+	up_write(&x_blob_lock);
+	return count;
+}
+
+static int x_blob_mmap(struct file *file, struct kobject *kobj,
+		       struct bin_attribute *attr, struct vm_area_struct *vma)
+{
+	/* Checks that the range fits in the blob */
+	return remap_vmalloc_range(vma, x_blob, vma->vm_pgoff);
+}
+
+static struct bin_attribute x_blob_attr = {
+	.attr = { .name = "data", .mode = 0644 },
+	.read = x_blob_read,
+	.write = x_blob_write,
+	.mmap = x_blob_mmap,
+};
+
+
+static int x_blob_create(void)
+{
+	int res;
+
+	if (!blob_size)
+		return 0;
+
+	/* Zeroed and suitable for remap_vmalloc_range() */
+	x_blob = vmalloc_user(PAGE_ALIGN(blob_size));
+	if (!x_blob)
+		return -ENOMEM;
+	x_blob_attr.size = blob_size;
+
+	x_blob_dev = device_create(x_class, NULL, MKDEV(0, 0), NULL, "blob");
+	if (IS_ERR(x_blob_dev)) {
+		res = PTR_ERR(x_blob_dev);
+		goto err_dev;
+	}
+	res = device_create_bin_file(x_blob_dev, &x_blob_attr);
+	if (res)
+		goto err_file;
+	return 0;
+
+err_file:
+	device_destroy(x_class, MKDEV(0, 0));
+err_dev:
+	vfree(x_blob);
+	x_blob = NULL;
+	return res;
+}
+
+static void x_blob_destroy(void)
+{
+	if (!x_blob)
+		return;
+	device_remove_bin_file(x_blob_dev, &x_blob_attr);
+	device_destroy(x_class, MKDEV(0, 0));
+	/* Existing mappings hold their own page references */
+	vfree(x_blob);
+}
+
+
+static void x_log_destroy(void)
+{
+	struct x_entry *entry, *tmp;
+
+	list_for_each_entry_safe(entry, tmp, &x_log, list)
+		kmem_cache_free(x_cache, entry);
+	/* Entries trimmed earlier may still wait for their grace period */
+	rcu_barrier();
+	kmem_cache_destroy(x_cache);
+}
+
 int __init x_init(void)
 {
+	struct x_entry *entry;
 	int res;
 
+	x_cache = kmem_cache_create("x_entry", sizeof(struct x_entry), 0,
+				    SLAB_RECLAIM_ACCOUNT, NULL);
+	if (!x_cache)
+		return -ENOMEM;
+
+	entry = x_entry_alloc("Hello from module!\n", 19);
+	if (!entry) {
+		res = -ENOMEM;
+		goto err_log;
+	}
+	x_log_append(entry);
+
 	x_class = class_create(THIS_MODULE, "x-class");
-	if (IS_ERR(x_class))
+	if (IS_ERR(x_class)) {
 		pr_info("bad class create\n");
+		res = PTR_ERR(x_class);
+		goto err_log;
+	}
 	res = class_create_file(x_class, &class_attr_xxx);
+	if (res)
+		goto err_xxx;
+	res = class_create_file(x_class, &class_attr_xxx_log);
+	if (res)
+		goto err_log_attr;
+	res = class_create_file(x_class, &class_attr_xxx_stats);
+	if (res)
+		goto err_stats;
+	res = register_shrinker(&x_shrinker);
+	if (res)
+		goto err_shrinker;
+	res = x_blob_create();
+	if (res)
+		goto err_blob;
+
 	pr_info("'xxx' module initialized\n");
+	return 0;
+
+err_blob:
+	unregister_shrinker(&x_shrinker);
+err_shrinker:
+	class_remove_file(x_class, &class_attr_xxx_stats);
+err_stats:
+	class_remove_file(x_class, &class_attr_xxx_log);
+err_log_attr:
+	class_remove_file(x_class, &class_attr_xxx);
+err_xxx:
+	class_destroy(x_class);
+err_log:
+	x_log_destroy();
 	return res;
 }
 
 void x_cleanup(void)
 {
+	x_blob_destroy();
+	unregister_shrinker(&x_shrinker);
+	class_remove_file(x_class, &class_attr_xxx_stats);
+	class_remove_file(x_class, &class_attr_xxx_log);
 	class_remove_file(x_class, &class_attr_xxx);
 	class_destroy(x_class);
+	x_log_destroy();
 }
 
 module_init(x_init);
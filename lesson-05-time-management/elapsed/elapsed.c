@@ -0,0 +1,271 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/slab.h>
+#include <linux/atomic.h>
+#include <linux/math64.h>
+#include <linux/ktime.h>
+#include <linux/timekeeping.h>
+#include <linux/jiffies.h>
+#include <linux/sched/clock.h>
+#include <linux/preempt.h>
+#include <linux/version.h>
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Time passed since the previous read");
+MODULE_VERSION("0.1");
+
+
+#define MODULE_TAG		"elapsed "
+#define PROC_DIRECTORY	"elapsed"
+
+/*
+ * /proc/elapsed/file   - time since the previous read of this open file,
+ *                        since open() for the first one
+ * /proc/elapsed/global - time since the previous read by anybody,
+ *                        since module load for the first one
+ * /proc/elapsed/clocks - cost and granularity of the kernel clocks
+ *
+ * Values are "seconds.nanoseconds" of CLOCK_MONOTONIC. A read counts when
+ * it starts at offset 0, so both 'cat' and repeated pread(fd, 0) work.
+ */
+
+static unsigned int bench_loops = 1000000;
+module_param(bench_loops, uint, 0644);
+MODULE_PARM_DESC(bench_loops, "calls per clock in /proc/elapsed/clocks");
+
+static atomic64_t global_last;
+
+static struct proc_dir_entry *proc_dir;
+
+
+/*
+ * Reads of one timestamp may run concurrently (threads sharing the fd),
+ * the exchange keeps every interval counted exactly once. An interval is
+ * only consumed by a read that copied all of it: after a fault or into a
+ * too short buffer the previous timestamp is put back, unless another
+ * read has taken the next interval meanwhile.
+ */
+static ssize_t elapsed_read(atomic64_t *last, char __user *buffer,
+							size_t length, loff_t *offset)
+{
+	char text[32];
+	u64 now, prev;
+	u32 nsec;
+	u64 sec;
+	ssize_t ret;
+	int len;
+
+	if (*offset != 0)
+		return 0;
+
+	now = ktime_get_ns();
+	prev = atomic64_xchg(last, now);
+	sec = div_u64_rem(now - prev, NSEC_PER_SEC, &nsec);
+	len = snprintf(text, sizeof(text), "%llu.%09u\n", sec, nsec);
+
+	ret = simple_read_from_buffer(buffer, length, offset, text, len);
+	if (ret != len)
+		atomic64_cmpxchg(last, now, prev);
+	return ret;
+}
+
+
+/* Per open file: the timestamp lives in private_data */
+static int file_open(struct inode *inode, struct file *file_p)
+{
+	atomic64_t *last = kmalloc(sizeof(*last), GFP_KERNEL);
+
+	if (!last)
+		return -ENOMEM;
+	atomic64_set(last, ktime_get_ns());
+	file_p->private_data = last;
+	return 0;
+}
+
+
+static int file_release(struct inode *inode, struct file *file_p)
+{
+	kfree(file_p->private_data);
+	return 0;
+}
+
+
+static ssize_t file_read(struct file *file_p, char __user *buffer,
+						 size_t length, loff_t *offset)
+{
+	return elapsed_read(file_p->private_data, buffer, length, offset);
+}
+
+
+static ssize_t global_read(struct file *file_p, char __user *buffer,
+						   size_t length, loff_t *offset)
+{
+	return elapsed_read(&global_last, buffer, length, offset);
+}
+
+
+static const struct file_operations file_fops = {
+	.owner   = THIS_MODULE,
+	.open    = file_open,
+	.read    = file_read,
+	.llseek  = default_llseek,
+	.release = file_release,
+};
+
+static const struct file_operations global_fops = {
+	.owner  = THIS_MODULE,
+	.read   = global_read,
+	.llseek = default_llseek,
+};
+
+
+/* Clock read cost ----------------------------------------------------- */
+
+static u64 clock_ktime_get(void)
+{
+	return ktime_get_ns();
+}
+
+static u64 clock_ktime_get_coarse(void)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
+	return ktime_get_coarse_ns();
+#else
+	struct timespec64 ts = get_monotonic_coarse64();
+
+	return timespec64_to_ns(&ts);
+#endif
+}
+
+static u64 clock_ktime_get_raw(void)
+{
+	return ktime_get_raw_ns();
+}
+
+static u64 clock_local_clock(void)
+{
+	return local_clock();
+}
+
+static u64 clock_jiffies(void)
+{
+	return get_jiffies_64();
+}
+
+static const struct {
+	const char *name;
+	u64 (*read)(void);
+	bool ticks;		/* value is in jiffies, not ns */
+} clocks[] = {
+	{ "ktime_get",        clock_ktime_get },
+	{ "ktime_get_coarse", clock_ktime_get_coarse },
+	{ "ktime_get_raw",    clock_ktime_get_raw },
+	{ "local_clock",      clock_local_clock },
+	{ "jiffies",          clock_jiffies, true },
+};
+
+
+#define BENCH_CHUNK	10000
+
+/*
+ * Calls one clock bench_loops times. Preemption is off only for chunks
+ * of BENCH_CHUNK calls, so a large bench_loops cannot cause soft lockups;
+ * the time between chunks is not counted. Granularity is the smallest
+ * non-zero step seen between consecutive values within a chunk. The cost
+ * includes the indirect call, the same for every clock.
+ */
+static void clock_bench(struct seq_file *m, int i)
+{
+	u64 (*read)(void) = clocks[i].read;
+	u64 start, total = 0, prev, val, step = U64_MAX;
+	unsigned int loops = READ_ONCE(bench_loops);
+	unsigned int n, done, chunk;
+
+	for (done = 0; done < loops; done += chunk) {
+		chunk = min_t(unsigned int, loops - done, BENCH_CHUNK);
+		preempt_disable();
+		prev = read();
+		start = ktime_get_ns();
+		for (n = 0; n < chunk; n++) {
+			val = read();
+			if (val != prev && val - prev < step)
+				step = val - prev;
+			prev = val;
+		}
+		total += ktime_get_ns() - start;
+		preempt_enable();
+		cond_resched();
+	}
+
+	if (clocks[i].ticks && step != U64_MAX)
+		step = jiffies_to_nsecs(step);
+	seq_printf(m, "%-18s %8llu", clocks[i].name,
+			   div_u64(total * 1000, loops ?: 1));
+	if (step == U64_MAX)
+		seq_puts(m, "          -\n");
+	else
+		seq_printf(m, " %10llu\n", step);
+}
+
+
+static int clocks_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	seq_printf(m, "%-18s %8s %10s\n", "clock", "ps/call", "step ns");
+	for (i = 0; i < ARRAY_SIZE(clocks); i++) {
+		clock_bench(m, i);
+		cond_resched();
+	}
+	return 0;
+}
+
+
+static int clocks_open(struct inode *inode, struct file *file_p)
+{
+	return single_open(file_p, clocks_show, NULL);
+}
+
+
+static const struct file_operations clocks_fops = {
+	.owner   = THIS_MODULE,
+	.open    = clocks_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+
+static int __init elapsed_init(void)
+{
+	atomic64_set(&global_last, ktime_get_ns());
+
+	proc_dir = proc_mkdir(PROC_DIRECTORY, NULL);
+	if (proc_dir == NULL)
+		return -ENOMEM;
+
+	if (!proc_create("file", S_IFREG | S_IRUGO, proc_dir, &file_fops) ||
+		!proc_create("global", S_IFREG | S_IRUGO, proc_dir, &global_fops) ||
+		!proc_create("clocks", S_IFREG | S_IRUSR, proc_dir, &clocks_fops)) {
+		remove_proc_subtree(PROC_DIRECTORY, NULL);
+		pr_err(MODULE_TAG "failed to load\n");
+		return -ENOMEM;
+	}
+
+	pr_notice(MODULE_TAG "loaded\n");
+	return 0;
+}
+
+
+static void __exit elapsed_exit(void)
+{
+	remove_proc_subtree(PROC_DIRECTORY, NULL);
+	pr_notice(MODULE_TAG "exited\n");
+}
+
+
+module_init(elapsed_init);
+module_exit(elapsed_exit);
@@ -0,0 +1,240 @@
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/string.h>
+#include <linux/bitops.h>
+#include <linux/sched.h>
+
+#include "bignum.h"
+
+
+/* log2(phi) = 0.6942..., plus room for carries and the extra step */
+unsigned int bignum_fib_limbs(unsigned long n)
+{
+	return (u64)(n + 1) * 6943 / 10000 / 32 + 4;
+}
+
+
+struct bignum *bignum_alloc(unsigned int cap, gfp_t gfp)
+{
+	struct bignum *a;
+
+	a = kvmalloc(sizeof(*a) + (size_t)cap * sizeof(u32), gfp);
+	if (a) {
+		a->len = 0;
+		a->cap = cap;
+	}
+	return a;
+}
+
+
+void bignum_free(struct bignum *a)
+{
+	kvfree(a);
+}
+
+
+/* Grow *a (NULL allocates) to hold cap limbs, keeping its value */
+int bignum_reserve(struct bignum **a, unsigned int cap, gfp_t gfp)
+{
+	struct bignum *r;
+
+	if (*a && (*a)->cap >= cap)
+		return 0;
+	r = bignum_alloc(cap, gfp);
+	if (!r)
+		return -ENOMEM;
+	if (*a) {
+		bignum_copy(r, *a);
+		bignum_free(*a);
+	}
+	*a = r;
+	return 0;
+}
+
+
+static void bignum_trim(struct bignum *r)
+{
+	while (r->len && r->limb[r->len - 1] == 0)
+		r->len--;
+}
+
+
+void bignum_set(struct bignum *r, u32 value)
+{
+	r->len = 0;
+	if (value && r->cap) {
+		r->limb[0] = value;
+		r->len = 1;
+	}
+}
+
+
+void bignum_copy(struct bignum *r, const struct bignum *a)
+{
+	r->len = min(a->len, r->cap);
+	memcpy(r->limb, a->limb, r->len * sizeof(u32));
+}
+
+
+/* r = a + b, r may be a or b */
+void bignum_add(struct bignum *r, const struct bignum *a,
+				const struct bignum *b)
+{
+	unsigned int len = min(max(a->len, b->len), r->cap);
+	unsigned int i;
+	u64 carry = 0;
+
+	for (i = 0; i < len; i++) {
+		carry += (u64)(i < a->len ? a->limb[i] : 0) +
+				 (i < b->len ? b->limb[i] : 0);
+		r->limb[i] = (u32)carry;
+		carry >>= 32;
+	}
+	if (carry && len < r->cap)
+		r->limb[len++] = (u32)carry;
+	r->len = len;
+}
+
+
+/* r = a - b for a >= b, r may be a or b */
+void bignum_sub(struct bignum *r, const struct bignum *a,
+				const struct bignum *b)
+{
+	unsigned int i;
+	s64 borrow = 0;
+
+	unsigned int len = min(a->len, r->cap);
+
+	for (i = 0; i < len; i++) {
+		borrow += (s64)a->limb[i] - (i < b->len ? b->limb[i] : 0);
+		r->limb[i] = (u32)borrow;
+		borrow >>= 32;	/* arithmetic: 0 or -1 */
+	}
+	r->len = len;
+	bignum_trim(r);
+}
+
+
+/* r = a * b, schoolbook; r must be neither a nor b */
+void bignum_mul(struct bignum *r, const struct bignum *a,
+				const struct bignum *b)
+{
+	unsigned int len = min(a->len + b->len, r->cap);
+	unsigned int i, j;
+	u64 carry;
+
+	memset(r->limb, 0, len * sizeof(u32));
+	for (i = 0; i < a->len; i++) {
+		carry = 0;
+		for (j = 0; j < b->len && i + j < len; j++) {
+			carry += (u64)a->limb[i] * b->limb[j] + r->limb[i + j];
+			r->limb[i + j] = (u32)carry;
+			carry >>= 32;
+		}
+		if (i + j < len)
+			r->limb[i + j] = (u32)carry;
+		/* Quadratic: large operands take long */
+		if ((i & 255) == 255)
+			cond_resched();
+	}
+	r->len = len;
+	bignum_trim(r);
+}
+
+
+/*
+ * Fast doubling, O(log n) multiplications:
+ *   F(2k)   = F(k) * (2 * F(k+1) - F(k))
+ *   F(2k+1) = F(k)^2 + F(k+1)^2
+ * Returns a new number, NULL when out of memory.
+ */
+struct bignum *bignum_fib(unsigned long n)
+{
+	unsigned int cap = bignum_fib_limbs(n);
+	struct bignum *a, *b, *c, *d, *t;
+	int bit;
+
+	a = bignum_alloc(cap, GFP_KERNEL);
+	b = bignum_alloc(cap, GFP_KERNEL);
+	c = bignum_alloc(cap, GFP_KERNEL);
+	d = bignum_alloc(cap, GFP_KERNEL);
+	t = bignum_alloc(cap, GFP_KERNEL);
+	if (!a || !b || !c || !d || !t) {
+		bignum_free(a);
+		a = NULL;
+		goto out;
+	}
+
+	bignum_set(a, 0);	/* F(0) */
+	bignum_set(b, 1);	/* F(1) */
+	for (bit = n ? fls_long(n) - 1 : -1; bit >= 0; bit--) {
+		/* c = F(2k) */
+		bignum_add(t, b, b);
+		bignum_sub(t, t, a);
+		bignum_mul(c, a, t);
+		/* d = F(2k+1) */
+		bignum_mul(t, a, a);
+		bignum_mul(d, b, b);
+		bignum_add(d, d, t);
+
+		if (n & (1UL << bit)) {
+			bignum_copy(a, d);
+			bignum_add(b, c, d);
+		} else {
+			bignum_copy(a, c);
+			bignum_copy(b, d);
+		}
+		cond_resched();
+	}
+out:
+	bignum_free(b);
+	bignum_free(c);
+	bignum_free(d);
+	bignum_free(t);
+	return a;
+}
+
+
+/* Decimal string, kvfree() it */
+char *bignum_to_dec(const struct bignum *a, gfp_t gfp)
+{
+	unsigned int len = a->len, nchunks = 0, i;
+	u32 *tmp, *chunks;
+	char *str, *p;
+	u32 rem32;
+	u64 rem;
+
+	/* 9 decimal digits per chunk, 32 bits hold less than 9.7 digits */
+	tmp = kvmalloc_array(len + 1, sizeof(u32), gfp);
+	chunks = kvmalloc_array(len * 10 / 9 + 2, sizeof(u32), gfp);
+	str = kvmalloc(len * 10 + 2, gfp);
+	if (!tmp || !chunks || !str) {
+		kvfree(str);
+		str = NULL;
+		goto out;
+	}
+
+	memcpy(tmp, a->limb, len * sizeof(u32));
+	do {
+		rem = 0;
+		for (i = len; i-- > 0; ) {
+			rem = (rem << 32) | tmp[i];
+			tmp[i] = div_u64_rem(rem, 1000000000, &rem32);
+			rem = rem32;
+		}
+		if ((nchunks & 255) == 255)
+			cond_resched();
+		chunks[nchunks++] = (u32)rem;
+		while (len && tmp[len - 1] == 0)
+			len--;
+	} while (len);
+
+	p = str + sprintf(str, "%u", chunks[--nchunks]);
+	while (nchunks)
+		p += sprintf(p, "%09u", chunks[--nchunks]);
+out:
+	kvfree(tmp);
+	kvfree(chunks);
+	return str;
+}
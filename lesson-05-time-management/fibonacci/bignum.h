@@ -0,0 +1,40 @@
+#ifndef _FIB_BIGNUM_H
+#define _FIB_BIGNUM_H
+
+#include <linux/types.h>
+#include <linux/gfp.h>
+
+
+/*
+ * Unsigned arbitrary precision integers, little-endian 32-bit limbs.
+ * A number is allocated for a capacity of limbs and results are cut to
+ * the capacity of the destination, so callers size them up front. Small
+ * numbers come from the kmalloc slabs, large ones from vmalloc.
+ * Everything here may sleep.
+ */
+struct bignum {
+	unsigned int len;	/* used limbs, no leading zeros, 0 is len 0 */
+	unsigned int cap;	/* allocated limbs */
+	u32 limb[];
+};
+
+
+/* Limbs needed by the fast doubling steps up to F(n) */
+unsigned int bignum_fib_limbs(unsigned long n);
+
+struct bignum *bignum_alloc(unsigned int cap, gfp_t gfp);
+void bignum_free(struct bignum *a);
+int bignum_reserve(struct bignum **a, unsigned int cap, gfp_t gfp);
+
+void bignum_set(struct bignum *r, u32 value);
+void bignum_copy(struct bignum *r, const struct bignum *a);
+void bignum_add(struct bignum *r, const struct bignum *a,
+				const struct bignum *b);
+void bignum_sub(struct bignum *r, const struct bignum *a,
+				const struct bignum *b);
+void bignum_mul(struct bignum *r, const struct bignum *a,
+				const struct bignum *b);
+struct bignum *bignum_fib(unsigned long n);
+char *bignum_to_dec(const struct bignum *a, gfp_t gfp);
+
+#endif /* _FIB_BIGNUM_H */
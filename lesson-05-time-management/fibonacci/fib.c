@@ -0,0 +1,439 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/err.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+#include "bignum.h"
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Fibonacci sequence, one element per period");
+MODULE_VERSION("0.1");
+
+
+#define MODULE_TAG		"fibonacci "
+#define PROC_DIRECTORY	"fibonacci"
+
+/*
+ * /proc/fibonacci/seq   - "index value" for the terms generated so far,
+ *                         the last 'window' of them
+ * /proc/fibonacci/nth   - write n, read back "n F(n)" computed directly,
+ *                         root only, repeated reads of one n are cached
+ * /proc/fibonacci/bench - cost of F(n) by fast doubling and of printing it
+ *
+ * An hrtimer fires every period_ms and queues a work item that adds the
+ * two previous terms, so a step is one big number addition whatever the
+ * index. Each ring slot holds a number just large enough for its term;
+ * the work allocates the new one and frees the term it replaces, which
+ * needs process context, hence the work item. nth and bench allocate
+ * their own numbers and are limited separately by nth_max.
+ */
+
+static unsigned long max_index = 100000;
+module_param(max_index, ulong, 0444);
+MODULE_PARM_DESC(max_index, "index at which the generator stops");
+
+static unsigned long nth_max = 1000000;
+module_param(nth_max, ulong, 0444);
+MODULE_PARM_DESC(nth_max, "largest index served by nth and bench");
+
+static unsigned int period_ms = 1000;
+module_param(period_ms, uint, 0444);
+MODULE_PARM_DESC(period_ms, "time between two generated terms");
+
+static unsigned int window = 64;
+module_param(window, uint, 0444);
+MODULE_PARM_DESC(window, "generated terms kept for readers, at least 3");
+
+static struct bignum **fib_ring;	/* term i is in fib_ring[i % window] */
+static unsigned long fib_next;		/* index of the next term */
+static DEFINE_MUTEX(fib_lock);		/* ring slots and fib_next */
+
+static struct hrtimer fib_timer;
+static struct work_struct fib_work;
+
+static unsigned long fib_nth = 100;
+static DEFINE_MUTEX(nth_lock);		/* the cached decimal F(nth_n) */
+static char *nth_dec;
+static unsigned long nth_n;
+
+static struct proc_dir_entry *proc_dir;
+
+
+/*
+ * The only writer of the ring, a work item never runs concurrently with
+ * itself, so the previous terms are read without the lock.
+ */
+static void fib_step(struct work_struct *work)
+{
+	unsigned long n = fib_next;
+	struct bignum *a, *b, *r, *old;
+
+	if (n < 2) {
+		r = bignum_alloc(1, GFP_KERNEL);
+		if (r)
+			bignum_set(r, n);
+	} else {
+		a = fib_ring[(n - 1) % window];
+		b = fib_ring[(n - 2) % window];
+		r = bignum_alloc(max(a->len, b->len) + 1, GFP_KERNEL);
+		if (r)
+			bignum_add(r, a, b);
+	}
+	if (!r) {
+		pr_warn_ratelimited(MODULE_TAG "no memory for term %lu\n", n);
+		return;		/* retried on the next tick */
+	}
+
+	mutex_lock(&fib_lock);
+	old = fib_ring[n % window];
+	fib_ring[n % window] = r;
+	WRITE_ONCE(fib_next, n + 1);
+	mutex_unlock(&fib_lock);
+	bignum_free(old);
+}
+
+
+static enum hrtimer_restart fib_tick(struct hrtimer *timer)
+{
+	if (READ_ONCE(fib_next) > max_index) {
+		pr_info(MODULE_TAG "reached index %lu, stopped\n", max_index);
+		return HRTIMER_NORESTART;
+	}
+	schedule_work(&fib_work);
+	hrtimer_forward_now(timer, ms_to_ktime(period_ms));
+	return HRTIMER_RESTART;
+}
+
+
+/* Sequence reader ----------------------------------------------------- */
+
+struct fib_iter {
+	unsigned long index;
+	struct bignum *value;	/* grown to the largest term read */
+};
+
+
+/*
+ * Copies term *pos out of the ring. Positions are indices; terms the ring
+ * has already dropped are skipped, so a slow reader sees a gap rather than
+ * stale values.
+ */
+static void *fib_fetch(struct fib_iter *it, loff_t *pos)
+{
+	struct bignum *src;
+	unsigned long first;
+	void *v = NULL;
+
+	mutex_lock(&fib_lock);
+	first = fib_next > window ? fib_next - window : 0;
+	if (*pos < first)
+		*pos = first;
+	if (*pos < fib_next) {
+		it->index = *pos;
+		src = fib_ring[it->index % window];
+		if (bignum_reserve(&it->value, src->len, GFP_KERNEL)) {
+			v = ERR_PTR(-ENOMEM);
+		} else {
+			bignum_copy(it->value, src);
+			v = it;
+		}
+	}
+	mutex_unlock(&fib_lock);
+	return v;
+}
+
+
+static void *fib_seq_start(struct seq_file *m, loff_t *pos)
+{
+	return fib_fetch(m->private, pos);
+}
+
+
+static void *fib_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return fib_fetch(m->private, pos);
+}
+
+
+static void fib_seq_stop(struct seq_file *m, void *v)
+{
+}
+
+
+static int fib_seq_show(struct seq_file *m, void *v)
+{
+	struct fib_iter *it = v;
+	char *dec = bignum_to_dec(it->value, GFP_KERNEL);
+
+	if (!dec)
+		return -ENOMEM;
+	seq_printf(m, "%lu %s\n", it->index, dec);
+	kvfree(dec);
+	return 0;
+}
+
+
+static const struct seq_operations fib_seq_ops = {
+	.start = fib_seq_start,
+	.next  = fib_seq_next,
+	.stop  = fib_seq_stop,
+	.show  = fib_seq_show,
+};
+
+
+static int fib_seq_open(struct inode *inode, struct file *file_p)
+{
+	struct fib_iter *it;
+
+	it = __seq_open_private(file_p, &fib_seq_ops, sizeof(*it));
+	return it ? 0 : -ENOMEM;
+}
+
+
+static int fib_seq_release(struct inode *inode, struct file *file_p)
+{
+	struct fib_iter *it = ((struct seq_file *)file_p->private_data)->private;
+
+	bignum_free(it->value);
+	return seq_release_private(inode, file_p);
+}
+
+
+static const struct file_operations seq_fops = {
+	.owner   = THIS_MODULE,
+	.open    = fib_seq_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = fib_seq_release,
+};
+
+
+/* Random access ------------------------------------------------------- */
+
+/* A large n takes about a second, so only a new n is computed */
+static int nth_show(struct seq_file *m, void *v)
+{
+	unsigned long n = READ_ONCE(fib_nth);
+	struct bignum *r;
+	char *dec = NULL;
+	int err = 0;
+
+	mutex_lock(&nth_lock);
+	if (!nth_dec || nth_n != n) {
+		r = bignum_fib(n);
+		if (r)
+			dec = bignum_to_dec(r, GFP_KERNEL);
+		bignum_free(r);
+		if (dec) {
+			kvfree(nth_dec);
+			nth_dec = dec;
+			nth_n = n;
+		}
+	}
+	if (nth_dec && nth_n == n)
+		seq_printf(m, "%lu %s\n", n, nth_dec);
+	else
+		err = -ENOMEM;
+	mutex_unlock(&nth_lock);
+	return err;
+}
+
+
+static int nth_open(struct inode *inode, struct file *file_p)
+{
+	return single_open(file_p, nth_show, NULL);
+}
+
+
+static ssize_t nth_write(struct file *file_p, const char __user *buffer,
+						 size_t length, loff_t *offset)
+{
+	unsigned long n;
+	int err;
+
+	err = kstrtoul_from_user(buffer, length, 0, &n);
+	if (err)
+		return err;
+	if (n > nth_max)
+		return -EINVAL;
+	WRITE_ONCE(fib_nth, n);
+	return length;
+}
+
+
+static const struct file_operations nth_fops = {
+	.owner   = THIS_MODULE,
+	.open    = nth_open,
+	.read    = seq_read,
+	.write   = nth_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+
+/* Benchmark ----------------------------------------------------------- */
+
+/*
+ * Average ns of F(n), of its decimal form and of one generation step at
+ * that size. Each is repeated for at least a millisecond so that small
+ * indices are not lost in the clock resolution.
+ */
+static int fib_bench(struct seq_file *m, unsigned long n, u64 *total)
+{
+	struct bignum *r = NULL, *t = NULL;
+	u64 start, fib_ns, dec_ns, add_ns;
+	unsigned int loops;
+	char *dec;
+	int err = -ENOMEM;
+
+	loops = 0;
+	start = ktime_get_ns();
+	do {
+		bignum_free(r);
+		r = bignum_fib(n);
+		if (!r)
+			goto out;
+		loops++;
+	} while (ktime_get_ns() - start < NSEC_PER_MSEC);
+	fib_ns = div_u64(ktime_get_ns() - start, loops);
+
+	loops = 0;
+	start = ktime_get_ns();
+	do {
+		dec = bignum_to_dec(r, GFP_KERNEL);
+		if (!dec)
+			goto out;
+		kvfree(dec);
+		loops++;
+		cond_resched();
+	} while (ktime_get_ns() - start < NSEC_PER_MSEC);
+	dec_ns = div_u64(ktime_get_ns() - start, loops);
+
+	t = bignum_alloc(r->len + 1, GFP_KERNEL);
+	if (!t)
+		goto out;
+	loops = 0;
+	start = ktime_get_ns();
+	do {
+		bignum_add(t, r, r);
+		loops++;
+	} while (ktime_get_ns() - start < NSEC_PER_MSEC);
+	add_ns = div_u64(ktime_get_ns() - start, loops);
+
+	seq_printf(m, "%10lu %8u %12llu %12llu %10llu\n",
+			   n, r->len, fib_ns, dec_ns, add_ns);
+	*total = fib_ns + dec_ns;
+	err = 0;
+out:
+	bignum_free(r);
+	bignum_free(t);
+	return err;
+}
+
+
+/*
+ * Doubles the index up to nth_max and reports the largest one whose F(n)
+ * can be computed and printed within one period from scratch.
+ */
+static int bench_show(struct seq_file *m, void *v)
+{
+	u64 period_ns = (u64)period_ms * NSEC_PER_MSEC, total;
+	unsigned long n, served = 0;
+	int err;
+
+	seq_printf(m, "%10s %8s %12s %12s %10s\n",
+			   "index", "limbs", "fib ns", "decimal ns", "step ns");
+	for (n = min(1000UL, nth_max); ; n = min(n * 2, nth_max)) {
+		err = fib_bench(m, n, &total);
+		if (err)
+			return err;
+		if (total <= period_ns)
+			served = n;
+		if (n == nth_max || total > period_ns)
+			break;
+	}
+	seq_printf(m, "served within %u ms: index %lu%s\n", period_ms, served,
+			   served == nth_max ? " (nth_max)" : "");
+	return 0;
+}
+
+
+static int bench_open(struct inode *inode, struct file *file_p)
+{
+	return single_open(file_p, bench_show, NULL);
+}
+
+
+static const struct file_operations bench_fops = {
+	.owner   = THIS_MODULE,
+	.open    = bench_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+
+static void fib_ring_free(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < window; i++)
+		bignum_free(fib_ring[i]);
+	kfree(fib_ring);
+}
+
+
+static int __init fib_init(void)
+{
+	if (window < 3 || period_ms == 0)
+		return -EINVAL;
+
+	fib_ring = kcalloc(window, sizeof(*fib_ring), GFP_KERNEL);
+	if (!fib_ring)
+		return -ENOMEM;
+	INIT_WORK(&fib_work, fib_step);
+
+	proc_dir = proc_mkdir(PROC_DIRECTORY, NULL);
+	if (proc_dir == NULL ||
+		!proc_create("seq", S_IFREG | S_IRUGO, proc_dir, &seq_fops) ||
+		!proc_create("nth", S_IFREG | S_IRUSR | S_IWUSR, proc_dir,
+					 &nth_fops) ||
+		!proc_create("bench", S_IFREG | S_IRUSR, proc_dir, &bench_fops)) {
+		remove_proc_subtree(PROC_DIRECTORY, NULL);
+		kfree(fib_ring);
+		pr_err(MODULE_TAG "failed to load\n");
+		return -ENOMEM;
+	}
+
+	hrtimer_init(&fib_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	fib_timer.function = fib_tick;
+	hrtimer_start(&fib_timer, ms_to_ktime(period_ms), HRTIMER_MODE_REL);
+
+	pr_notice(MODULE_TAG "loaded\n");
+	return 0;
+}
+
+
+static void __exit fib_exit(void)
+{
+	hrtimer_cancel(&fib_timer);
+	cancel_work_sync(&fib_work);
+	remove_proc_subtree(PROC_DIRECTORY, NULL);
+	fib_ring_free();
+	kvfree(nth_dec);
+	pr_notice(MODULE_TAG "exited\n");
+}
+
+
+module_init(fib_init);
+module_exit(fib_exit);
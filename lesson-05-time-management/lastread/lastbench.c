@@ -0,0 +1,154 @@
+/*
+ * Cost of getting the time of the previous read: read() of
+ * /proc/lastread/page versus loads from its read-only mapping.
+ *
+ * An updater thread keeps reading /proc/lastread/time so the page changes
+ * during the measurement. Both paths check every snapshot: count must
+ * never go back and last_ns must not be older than prev_ns.
+ *
+ * usage: lastbench [queries] [updater interval us, 0 = flat out]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "lastread.h"
+
+#define TIME_PATH	"/proc/lastread/time"
+#define PAGE_PATH	"/proc/lastread/page"
+
+static volatile int stop;
+static int interval_us = 100;
+
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static int open_or_die(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0) {
+		fprintf(stderr, "%s: %m\n", path);
+		exit(EXIT_FAILURE);
+	}
+	return fd;
+}
+
+
+static void *updater(void *arg)
+{
+	int fd = open_or_die(TIME_PATH);
+	char buf[32];
+	long updates = 0;
+
+	while (!stop) {
+		if (pread(fd, buf, sizeof(buf), 0) < 0) {
+			perror(TIME_PATH);
+			exit(EXIT_FAILURE);
+		}
+		updates++;
+		if (interval_us)
+			usleep(interval_us);
+	}
+	close(fd);
+	return (void *)updates;
+}
+
+
+/* Same protocol as the kernel's page_read() */
+static void snapshot(const struct lastread_page *page,
+		     struct lastread_page *snap, long *retries)
+{
+	__u32 seq;
+
+	for (;;) {
+		seq = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+		*snap = *page;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (!(seq & 1) && seq == __atomic_load_n(&page->seq,
+							 __ATOMIC_RELAXED))
+			break;
+		(*retries)++;
+	}
+}
+
+
+static int check(const struct lastread_page *snap, __u64 *count)
+{
+	int bad = snap->count < *count ||
+		  (snap->count > 1 && snap->last_ns < snap->prev_ns);
+
+	*count = snap->count;
+	return bad;
+}
+
+
+int main(int argc, char *argv[])
+{
+	long queries = argc > 1 ? atol(argv[1]) : 1000000;
+	struct lastread_page snap;
+	const struct lastread_page *page;
+	long i, bad, retries = 0;
+	pthread_t tid;
+	void *updates;
+	__u64 count;
+	double t;
+	int fd;
+
+	if (argc > 2)
+		interval_us = atoi(argv[2]);
+
+	fd = open_or_die(PAGE_PATH);
+	page = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+	if (page == MAP_FAILED) {
+		perror("mmap");
+		return EXIT_FAILURE;
+	}
+
+	pthread_create(&tid, NULL, updater, NULL);
+
+	count = 0;
+	bad = 0;
+	t = now();
+	for (i = 0; i < queries; i++) {
+		if (pread(fd, &snap, sizeof(snap), 0) != sizeof(snap)) {
+			perror("pread");
+			return EXIT_FAILURE;
+		}
+		bad += check(&snap, &count);
+	}
+	t = now() - t;
+	printf("read() %8.1f ns/query  inconsistent %ld\n",
+	       t * 1e9 / queries, bad);
+
+	count = 0;
+	bad = 0;
+	t = now();
+	for (i = 0; i < queries; i++) {
+		snapshot(page, &snap, &retries);
+		bad += check(&snap, &count);
+	}
+	t = now() - t;
+	printf("mmap   %8.1f ns/query  inconsistent %ld  retries %ld\n",
+	       t * 1e9 / queries, bad, retries);
+
+	stop = 1;
+	pthread_join(tid, &updates);
+	printf("updates during the run: %ld, last count %llu\n",
+	       (long)updates, (unsigned long long)snap.count);
+
+	close(fd);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/proc_fs.h>
+#include <linux/uaccess.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+
+#include "lastread.h"
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Absolute time of the previous read");
+MODULE_VERSION("0.1");
+
+
+#define MODULE_TAG		"lastread "
+#define PROC_DIRECTORY	"lastread"
+
+/*
+ * /proc/lastread/time - returns the absolute time of the previous read
+ *                       of this node as "seconds.nanoseconds"
+ * /proc/lastread/page - the same state as struct lastread_page: read()
+ *                       returns a copy, mmap() maps it read-only
+ */
+
+static struct lastread_page *lr_page;
+static DEFINE_SPINLOCK(lr_lock);	/* serializes updates of lr_page */
+
+static struct proc_dir_entry *proc_dir;
+
+
+static u64 lr_update(void)
+{
+	u64 now = ktime_get_real_ns();
+	u64 prev;
+
+	spin_lock(&lr_lock);
+	WRITE_ONCE(lr_page->seq, lr_page->seq + 1);
+	smp_wmb();
+	prev = lr_page->last_ns;
+	lr_page->prev_ns = prev;
+	lr_page->last_ns = now;
+	lr_page->count++;
+	smp_wmb();
+	WRITE_ONCE(lr_page->seq, lr_page->seq + 1);
+	spin_unlock(&lr_lock);
+
+	return prev;
+}
+
+
+static ssize_t time_read(struct file *file_p, char __user *buffer,
+						 size_t length, loff_t *offset)
+{
+	char text[32];
+	u32 nsec;
+	u64 sec;
+	int len;
+
+	if (*offset != 0)
+		return 0;
+
+	sec = div_u64_rem(lr_update(), NSEC_PER_SEC, &nsec);
+	len = snprintf(text, sizeof(text), "%llu.%09u\n", sec, nsec);
+	return simple_read_from_buffer(buffer, length, offset, text, len);
+}
+
+
+/* The syscall path readers of the page are compared against */
+static ssize_t page_read(struct file *file_p, char __user *buffer,
+						 size_t length, loff_t *offset)
+{
+	struct lastread_page snap;
+	unsigned int seq;
+
+	do {
+		seq = smp_load_acquire(&lr_page->seq);
+		snap = *lr_page;
+		smp_rmb();
+	} while ((seq & 1) || seq != READ_ONCE(lr_page->seq));
+
+	return simple_read_from_buffer(buffer, length, offset,
+								   &snap, sizeof(snap));
+}
+
+
+static int page_mmap(struct file *file_p, struct vm_area_struct *vma)
+{
+	if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start != PAGE_SIZE)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return vm_insert_page(vma, vma->vm_start, virt_to_page(lr_page));
+}
+
+
+static const struct file_operations time_fops = {
+	.owner  = THIS_MODULE,
+	.read   = time_read,
+	.llseek = default_llseek,
+};
+
+static const struct file_operations page_fops = {
+	.owner  = THIS_MODULE,
+	.read   = page_read,
+	.mmap   = page_mmap,
+	.llseek = default_llseek,
+};
+
+
+static int __init lastread_init(void)
+{
+	lr_page = (struct lastread_page *)get_zeroed_page(GFP_KERNEL);
+	if (lr_page == NULL)
+		return -ENOMEM;
+
+	proc_dir = proc_mkdir(PROC_DIRECTORY, NULL);
+	if (proc_dir == NULL ||
+		!proc_create("time", S_IFREG | S_IRUGO, proc_dir, &time_fops) ||
+		!proc_create("page", S_IFREG | S_IRUGO, proc_dir, &page_fops)) {
+		remove_proc_subtree(PROC_DIRECTORY, NULL);
+		free_page((unsigned long)lr_page);
+		pr_err(MODULE_TAG "failed to load\n");
+		return -ENOMEM;
+	}
+
+	pr_notice(MODULE_TAG "loaded\n");
+	return 0;
+}
+
+
+static void __exit lastread_exit(void)
+{
+	remove_proc_subtree(PROC_DIRECTORY, NULL);
+	/* Pages still mapped keep their own reference */
+	free_page((unsigned long)lr_page);
+	pr_notice(MODULE_TAG "exited\n");
+}
+
+
+module_init(lastread_init);
+module_exit(lastread_exit);
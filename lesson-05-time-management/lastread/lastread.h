@@ -0,0 +1,22 @@
+#ifndef _LASTREAD_H
+#define _LASTREAD_H
+
+#include <linux/types.h>
+
+/*
+ * Layout of the page mmap()ed read-only from /proc/lastread/page, and of
+ * what read() of that node returns.
+ *
+ * The kernel updates it on every read of /proc/lastread/time, vDSO style:
+ * seq is odd while an update is in progress. Readers retry while seq is
+ * odd or changed during their copy, so they never enter the kernel.
+ */
+struct lastread_page {
+	__u32 seq;
+	__u32 reserved;
+	__u64 count;		/* reads of /proc/lastread/time so far */
+	__u64 last_ns;		/* CLOCK_REALTIME of the latest one */
+	__u64 prev_ns;		/* and of the one before it */
+};
+
+#endif /* _LASTREAD_H */
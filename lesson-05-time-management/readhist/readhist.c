@@ -0,0 +1,344 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/hash.h>
+#include <linux/rculist.h>
+#include <linux/spinlock.h>
+#include <linux/atomic.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/log2.h>
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Per-PID histogram of the time between reads");
+MODULE_VERSION("0.1");
+
+
+#define MODULE_TAG		"readhist "
+#define PROC_DIRECTORY	"readhist"
+
+/*
+ * /proc/readhist/time   - instrumented node, returns CLOCK_MONOTONIC as
+ *                         "seconds.nanoseconds"
+ * /proc/readhist/report - per PID: reads and a log2 histogram of the ns
+ *                         between two reads; writing "clear" resets it
+ *
+ * Other modules instrument their own read handlers with readhist_account().
+ *
+ * Reads are accounted per process: all threads of a poller share one
+ * entry. The hot path is an RCU hash lookup of the process, an exchange
+ * of its last read time, as threads may read concurrently, and one atomic
+ * increment of a bucket. The table has a bucket per tracked process, so
+ * a lookup is about one entry. Entries are added under a spinlock on the
+ * first read.
+ *
+ * A process is the pid together with its start time, so a recycled pid
+ * gets a fresh entry and the dead process' one is dropped when it is
+ * found. With max_pids entries a new process replaces the one that has
+ * not read for the longest time, so a long running system keeps
+ * recording the processes that are active now.
+ */
+
+#define RH_BUCKETS		64	/* bucket b counts intervals in [2^b, 2^(b+1)) */
+#define RH_MAX_PIDS		(1U << 20)
+
+/* Fixed at load time, the hash table is sized from it */
+static unsigned int max_pids = 4096;
+module_param(max_pids, uint, 0444);
+MODULE_PARM_DESC(max_pids, "processes tracked, the least recently read is evicted");
+
+static bool enabled = true;
+module_param(enabled, bool, 0644);
+MODULE_PARM_DESC(enabled, "account reads");
+
+struct rh_entry {
+	struct hlist_node hash;
+	struct rcu_head rcu;
+	pid_t pid;
+	u64 start_time;		/* of the leader, tells a recycled pid apart */
+	char comm[TASK_COMM_LEN];
+	atomic64_t last_ns;
+	atomic_long_t bucket[RH_BUCKETS];
+};
+
+static struct hlist_head *rh_table;
+static unsigned int rh_hash_bits;
+static DEFINE_SPINLOCK(rh_lock);	/* serializes adds and removals */
+static unsigned int rh_count;
+static atomic_long_t rh_dropped;
+static unsigned long rh_evicted;	/* under rh_lock */
+
+static struct proc_dir_entry *proc_dir;
+
+
+static struct hlist_head *rh_head(pid_t pid)
+{
+	return &rh_table[hash_32(pid, rh_hash_bits)];
+}
+
+
+static struct rh_entry *rh_lookup(pid_t pid, u64 start_time)
+{
+	struct rh_entry *e;
+
+	hlist_for_each_entry_rcu(e, rh_head(pid), hash)
+		if (e->pid == pid && e->start_time == start_time)
+			return e;
+	return NULL;
+}
+
+
+/* Under rh_lock. Readers may still hold the entry until a grace period. */
+static void rh_del(struct rh_entry *e)
+{
+	hlist_del_rcu(&e->hash);
+	kfree_rcu(e, rcu);
+	rh_count--;
+}
+
+
+/*
+ * Under rh_lock. A full scan, but only when a new process reads while the
+ * table is full, and max_pids can't shrink, so one scan makes room.
+ */
+static void rh_evict_oldest(void)
+{
+	struct rh_entry *e, *oldest = NULL;
+	unsigned int bkt;
+
+	for (bkt = 0; bkt < (1U << rh_hash_bits); bkt++)
+		hlist_for_each_entry(e, &rh_table[bkt], hash)
+			if (!oldest || (s64)(atomic64_read(&e->last_ns) -
+								 atomic64_read(&oldest->last_ns)) < 0)
+				oldest = e;
+	if (oldest) {
+		rh_del(oldest);
+		rh_evicted++;
+	}
+}
+
+
+/* Slow path, first read of this process */
+static void rh_add(pid_t pid, u64 start_time, u64 now)
+{
+	struct hlist_node *tmp;
+	struct rh_entry *e, *old;
+	bool found = false;
+
+	e = kzalloc(sizeof(*e), GFP_KERNEL);
+	if (!e) {
+		atomic_long_inc(&rh_dropped);
+		return;
+	}
+	e->pid = pid;
+	e->start_time = start_time;
+	get_task_comm(e->comm, current->group_leader);
+	atomic64_set(&e->last_ns, now);
+
+	spin_lock(&rh_lock);
+	hlist_for_each_entry_safe(old, tmp, rh_head(pid), hash) {
+		if (old->pid != pid)
+			continue;
+		if (old->start_time == start_time)
+			found = true;		/* raced with another thread's add */
+		else
+			rh_del(old);		/* a dead process had this pid */
+	}
+	if (found) {
+		spin_unlock(&rh_lock);
+		kfree(e);
+		return;
+	}
+	if (rh_count >= max_pids)
+		rh_evict_oldest();
+	hlist_add_head_rcu(&e->hash, rh_head(pid));
+	rh_count++;
+	spin_unlock(&rh_lock);
+}
+
+
+/* Call from process context at the start of a read */
+void readhist_account(void)
+{
+	pid_t pid = task_tgid_nr(current);
+	u64 start_time = current->group_leader->start_time;
+	struct rh_entry *e;
+	u64 now;
+	s64 delta;
+
+	if (!READ_ONCE(enabled))
+		return;
+
+	now = ktime_get_ns();
+	rcu_read_lock();
+	e = rh_lookup(pid, start_time);
+	if (e) {
+		/* another thread may have stored a later time meanwhile */
+		delta = now - atomic64_xchg(&e->last_ns, now);
+		atomic_long_inc(&e->bucket[delta > 0 ? ilog2(delta) : 0]);
+	}
+	rcu_read_unlock();
+
+	if (!e)
+		rh_add(pid, start_time, now);
+}
+EXPORT_SYMBOL_GPL(readhist_account);
+
+
+static void rh_clear(void)
+{
+	struct hlist_node *tmp;
+	struct rh_entry *e;
+	unsigned int bkt;
+
+	spin_lock(&rh_lock);
+	for (bkt = 0; bkt < (1U << rh_hash_bits); bkt++)
+		hlist_for_each_entry_safe(e, tmp, &rh_table[bkt], hash)
+			rh_del(e);
+	rh_evicted = 0;
+	spin_unlock(&rh_lock);
+	atomic_long_set(&rh_dropped, 0);
+}
+
+
+static ssize_t time_read(struct file *file_p, char __user *buffer,
+						 size_t length, loff_t *offset)
+{
+	char text[32];
+	u32 nsec;
+	u64 sec;
+	int len;
+
+	if (*offset != 0)
+		return 0;
+
+	readhist_account();
+	sec = div_u64_rem(ktime_get_ns(), NSEC_PER_SEC, &nsec);
+	len = snprintf(text, sizeof(text), "%llu.%09u\n", sec, nsec);
+	return simple_read_from_buffer(buffer, length, offset, text, len);
+}
+
+
+static const struct file_operations time_fops = {
+	.owner  = THIS_MODULE,
+	.read   = time_read,
+	.llseek = default_llseek,
+};
+
+
+/*
+ * Counters are read without stopping the writers, a line may be one read
+ * behind its neighbours. The first read of a process is not an interval.
+ */
+static void rh_show_entry(struct seq_file *m, struct rh_entry *e)
+{
+	unsigned long count[RH_BUCKETS], total = 0;
+	int b;
+
+	for (b = 0; b < RH_BUCKETS; b++) {
+		count[b] = atomic_long_read(&e->bucket[b]);
+		total += count[b];
+	}
+
+	seq_printf(m, "%d %s intervals %lu\n", e->pid, e->comm, total);
+	for (b = 0; b < RH_BUCKETS; b++)
+		if (count[b])
+			seq_printf(m, "  %20llu ns %10lu\n", 1ULL << b, count[b]);
+}
+
+
+static int report_show(struct seq_file *m, void *v)
+{
+	struct rh_entry *e;
+	unsigned int bkt;
+
+	seq_printf(m, "processes %u, evicted %lu, dropped reads %ld\n",
+			   READ_ONCE(rh_count), READ_ONCE(rh_evicted),
+			   atomic_long_read(&rh_dropped));
+	rcu_read_lock();
+	for (bkt = 0; bkt < (1U << rh_hash_bits); bkt++)
+		hlist_for_each_entry_rcu(e, &rh_table[bkt], hash)
+			rh_show_entry(m, e);
+	rcu_read_unlock();
+	return 0;
+}
+
+
+static int report_open(struct inode *inode, struct file *file_p)
+{
+	return single_open(file_p, report_show, NULL);
+}
+
+
+static ssize_t report_write(struct file *file_p, const char __user *buffer,
+							size_t length, loff_t *offset)
+{
+	char cmd[8];
+
+	if (length == 0 || length >= sizeof(cmd))
+		return -EINVAL;
+	if (copy_from_user(cmd, buffer, length))
+		return -EFAULT;
+	cmd[length] = '\0';
+	if (!sysfs_streq(cmd, "clear"))
+		return -EINVAL;
+
+	rh_clear();
+	return length;
+}
+
+
+static const struct file_operations report_fops = {
+	.owner   = THIS_MODULE,
+	.open    = report_open,
+	.read    = seq_read,
+	.write   = report_write,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+
+static int __init readhist_init(void)
+{
+	if (max_pids == 0 || max_pids > RH_MAX_PIDS)
+		return -EINVAL;
+
+	/* as many buckets as entries */
+	rh_hash_bits = max_t(unsigned int, order_base_2(max_pids), 1);
+	rh_table = kvzalloc(sizeof(*rh_table) << rh_hash_bits, GFP_KERNEL);
+	if (!rh_table)
+		return -ENOMEM;
+
+	proc_dir = proc_mkdir(PROC_DIRECTORY, NULL);
+	if (proc_dir == NULL ||
+		!proc_create("time", S_IFREG | S_IRUGO, proc_dir, &time_fops) ||
+		!proc_create("report", S_IFREG | S_IRUGO | S_IWUSR, proc_dir,
+					 &report_fops)) {
+		remove_proc_subtree(PROC_DIRECTORY, NULL);
+		kvfree(rh_table);
+		pr_err(MODULE_TAG "failed to load\n");
+		return -ENOMEM;
+	}
+
+	pr_notice(MODULE_TAG "loaded\n");
+	return 0;
+}
+
+
+static void __exit readhist_exit(void)
+{
+	remove_proc_subtree(PROC_DIRECTORY, NULL);
+	rh_clear();
+	rcu_barrier();
+	kvfree(rh_table);
+	pr_notice(MODULE_TAG "exited\n");
+}
+
+
+module_init(readhist_init);
+module_exit(readhist_exit);
@@ -0,0 +1,72 @@
+#ifndef _MPU6050_DATA_H
+#define _MPU6050_DATA_H
+
+/*
+ * Bus independent sample processing.
+ * Nothing here touches the hardware, so the same code is built into the
+ * driver and into the userspace benchmark in tools/.
+ */
+
+#ifdef __KERNEL__
+#include <linux/string.h>
+#endif
+
+#include "mpu6050-sample.h"
+
+/* Accel, temperature and gyro output registers: ACCEL_XOUT_H..GYRO_ZOUT_L */
+#define MPU6050_BURST_LEN	(REG_EXT_SENS_DATA_00 - REG_ACCEL_XOUT_H)
+
+/* Offsets in the burst starting from ACCEL_XOUT_H */
+#define MPU6050_ACCEL_OFS	0
+#define MPU6050_TEMP_OFS	6
+#define MPU6050_GYRO_OFS	8
+
+/* Sensitivity with FS_SEL = 0 and AFS_SEL = 0, as set up at probe */
+#define MPU6050_ACCEL_LSB_PER_G		16384
+#define MPU6050_GYRO_LSB_PER_DPS	131
+
+static inline __s16 mpu6050_be16(const __u8 *p)
+{
+	return (__s16)((p[0] << 8) | p[1]);
+}
+
+/* Convert a raw burst (MPU6050_BURST_LEN + ext_len bytes) to a sample */
+static inline void mpu6050_decode(const __u8 *raw, int ext_len,
+				  struct mpu6050_sample *sample)
+{
+	int i;
+
+	/* Registers are big-endian: XOUT_H, XOUT_L, YOUT_H, ... */
+	for (i = 0; i < 3; i++) {
+		sample->accel[i] = mpu6050_be16(&raw[MPU6050_ACCEL_OFS + 2 * i]);
+		sample->gyro[i] = mpu6050_be16(&raw[MPU6050_GYRO_OFS + 2 * i]);
+	}
+	sample->temp = mpu6050_be16(&raw[MPU6050_TEMP_OFS]);
+	sample->ext_len = ext_len;
+	memcpy(sample->ext, &raw[MPU6050_BURST_LEN], ext_len);
+}
+
+/*
+ * Temperature in degrees C =
+ * (TEMP_OUT Register Value  as a signed quantity)/340 + 36.53
+ * 12420 = 36.53 * 340, 170 rounds to the nearest degree. Division
+ * truncates towards zero, so below zero the rounding goes the other way.
+ */
+static inline int mpu6050_temp_celsius(int temp)
+{
+	int t = temp + 12420;
+
+	return t >= 0 ? (t + 170) / 340 : (t - 170) / 340;
+}
+
+static inline int mpu6050_accel_mg(int raw)
+{
+	return raw * 1000 / MPU6050_ACCEL_LSB_PER_G;
+}
+
+static inline int mpu6050_gyro_mdps(int raw)
+{
+	return raw * 1000 / MPU6050_GYRO_LSB_PER_DPS;
+}
+
+#endif /* _MPU6050_DATA_H */
@@ -6,6 +6,15 @@
 #define REG_GYRO_CONFIG		0x1B
 #define REG_ACCEL_CONFIG	0x1C
 #define REG_FIFO_EN			0x23
+#define REG_I2C_MST_CTRL	0x24
+#define REG_I2C_SLV0_ADDR	0x25
+#define REG_I2C_SLV0_REG	0x26
+#define REG_I2C_SLV0_CTRL	0x27
+#define REG_I2C_SLV4_ADDR	0x31
+#define REG_I2C_SLV4_REG	0x32
+#define REG_I2C_SLV4_DO		0x33
+#define REG_I2C_SLV4_CTRL	0x34
+#define REG_I2C_MST_STATUS	0x36
 #define REG_INT_PIN_CFG		0x37
 #define REG_INT_ENABLE		0x38
 #define REG_ACCEL_XOUT_H	0x3B
@@ -22,12 +31,34 @@
 #define REG_GYRO_YOUT_L		0x46
 #define REG_GYRO_ZOUT_H		0x47
 #define REG_GYRO_ZOUT_L		0x48
+#define REG_EXT_SENS_DATA_00	0x49
 #define REG_USER_CTRL		0x6A
 #define REG_PWR_MGMT_1		0x6B
 #define REG_PWR_MGMT_2		0x6C
 #define REG_WHO_AM_I		0x75
 
+/* SLV0..SLV3 use three consecutive registers each: ADDR, REG, CTRL */
+#define REG_I2C_SLV_ADDR(n)	(REG_I2C_SLV0_ADDR + 3 * (n))
+#define REG_I2C_SLV_REG(n)	(REG_I2C_SLV0_REG + 3 * (n))
+#define REG_I2C_SLV_CTRL(n)	(REG_I2C_SLV0_CTRL + 3 * (n))
+
 /* Register values */
 #define MPU6050_WHO_AM_I	0x68
 
+/* Register bits */
+#define USER_CTRL_I2C_MST_EN	0x20
+#define I2C_MST_WAIT_FOR_ES		0x40
+#define I2C_MST_CLK_400KHZ		0x0D
+#define I2C_SLV_RNW				0x80
+#define I2C_SLV_EN				0x80
+#define I2C_SLV_BYTE_SW			0x40
+#define I2C_SLV_GRP				0x10
+#define I2C_SLV_LEN_MAX			0x0F
+#define I2C_MST_SLV4_DONE		0x40
+#define I2C_MST_SLV4_NACK		0x10
+
+/* Number of slaves which can be read into EXT_SENS_DATA and its size */
+#define MPU6050_AUX_SLAVES		4
+#define MPU6050_EXT_SENS_MAX	24
+
 #endif /* _MPU6050_REGS_H */
@@ -0,0 +1,109 @@
+#ifndef _MPU6050_RING_H
+#define _MPU6050_RING_H
+
+/*
+ * Single producer, many readers sample ring.
+ *
+ * The producer never waits for readers: it overwrites the oldest slot.
+ * Every reader keeps its own cursor (the sequence number of the next
+ * sample it wants) and validates the slot it copied with the slot's
+ * sequence number, seqlock style. A reader which was lapped by the
+ * producer gets -EOVERFLOW and its cursor is moved to the oldest sample
+ * still present in the ring.
+ *
+ * Sequence numbers are 32-bit and wrap, all comparisons are done on
+ * differences. The file is shared with the userspace stress test, which
+ * provides its own READ_ONCE()/smp_*() definitions.
+ */
+
+#ifdef __KERNEL__
+#include <linux/compiler.h>
+#include <linux/errno.h>
+#include <asm/barrier.h>
+#endif
+
+#include "mpu6050-sample.h"
+
+#define MPU6050_RING_SIZE	256	/* must be a power of two */
+#define MPU6050_RING_MASK	(MPU6050_RING_SIZE - 1)
+
+struct mpu6050_ring_slot {
+	unsigned int seq;
+	struct mpu6050_sample sample;
+};
+
+struct mpu6050_ring {
+	unsigned int head;	/* sequence number of the next sample */
+	struct mpu6050_ring_slot slot[MPU6050_RING_SIZE];
+};
+
+static inline void mpu6050_ring_init(struct mpu6050_ring *ring)
+{
+	unsigned int i;
+
+	ring->head = 0;
+	/* Any value not matching the slot index marks the slot as empty */
+	for (i = 0; i < MPU6050_RING_SIZE; i++)
+		ring->slot[i].seq = i - 1;
+}
+
+/* Producer side, callers must be serialized */
+static inline void mpu6050_ring_push(struct mpu6050_ring *ring,
+				     const struct mpu6050_sample *sample)
+{
+	unsigned int seq = ring->head;
+	struct mpu6050_ring_slot *slot = &ring->slot[seq & MPU6050_RING_MASK];
+
+	WRITE_ONCE(slot->seq, seq - 1);
+	smp_wmb();
+	slot->sample = *sample;
+	smp_store_release(&slot->seq, seq);
+	smp_store_release(&ring->head, seq + 1);
+}
+
+/* Oldest sample which cannot be overwritten by the next push */
+static inline unsigned int mpu6050_ring_tail(struct mpu6050_ring *ring)
+{
+	return smp_load_acquire(&ring->head) - MPU6050_RING_SIZE + 1;
+}
+
+static inline int mpu6050_ring_empty(struct mpu6050_ring *ring,
+				     unsigned int cursor)
+{
+	return smp_load_acquire(&ring->head) == cursor;
+}
+
+/*
+ * Copy the sample at *cursor and advance the cursor.
+ * Returns 0, -EAGAIN when there is nothing new yet or -EOVERFLOW when
+ * the reader fell behind and was moved forward.
+ */
+static inline int mpu6050_ring_read(struct mpu6050_ring *ring,
+				    unsigned int *cursor,
+				    struct mpu6050_sample *sample)
+{
+	unsigned int pos = *cursor;
+	unsigned int head = smp_load_acquire(&ring->head);
+	struct mpu6050_ring_slot *slot = &ring->slot[pos & MPU6050_RING_MASK];
+
+	if (head == pos)
+		return -EAGAIN;
+	if (head - pos > MPU6050_RING_SIZE)
+		goto overrun;
+
+	if (smp_load_acquire(&slot->seq) != pos)
+		goto overrun;
+	*sample = slot->sample;
+	smp_rmb();
+	if (READ_ONCE(slot->seq) != pos)
+		goto overrun;
+
+	*cursor = pos + 1;
+	return 0;
+
+overrun:
+	*cursor = mpu6050_ring_tail(ring);
+	return -EOVERFLOW;
+}
+
+#endif /* _MPU6050_RING_H */
@@ -0,0 +1,24 @@
+#ifndef _MPU6050_SAMPLE_H
+#define _MPU6050_SAMPLE_H
+
+#include <linux/types.h>
+
+#include "mpu6050-regs.h"
+
+/*
+ * One acquisition: accel, temperature, gyro and the auxiliary slaves'
+ * EXT_SENS_DATA are all fetched by a single burst read, so every field
+ * below belongs to the same moment in time.
+ * Values are raw register contents, already converted to host order.
+ */
+struct mpu6050_sample {
+	__u64 timestamp;	/* ktime_get_ns() after the burst completed */
+	__s16 accel[3];
+	__s16 gyro[3];
+	__s16 temp;
+	__u8 ext_len;		/* valid bytes in ext[] */
+	__u8 reserved;
+	__u8 ext[MPU6050_EXT_SENS_MAX];
+};
+
+#endif /* _MPU6050_SAMPLE_H */
@@ -4,53 +4,320 @@
 #include <linux/err.h>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #include "mpu6050-regs.h"
+#include "mpu6050-sample.h"
+#include "mpu6050-data.h"
+#include "mpu6050-ring.h"
+
+/*
+ * Auxiliary I2C master configuration.
+ * Each slot N (SLV0..SLV3) reads aux_len[N] bytes starting at aux_reg[N]
+ * from the slave at aux_addr[N]. The results are placed one after another
+ * into EXT_SENS_DATA, right behind GYRO_ZOUT_L, so they are fetched by the
+ * same burst as accel and gyro data.
+ * aux_init_reg/aux_init_val pairs are written once to the slot 0 slave
+ * before sampling starts (e.g. to put a magnetometer in continuous mode).
+ */
+static unsigned short aux_addr[MPU6050_AUX_SLAVES];
+static int aux_addr_num;
+module_param_array(aux_addr, ushort, &aux_addr_num, 0444);
+MODULE_PARM_DESC(aux_addr, "7-bit addresses of auxiliary I2C slaves");
+
+static unsigned short aux_reg[MPU6050_AUX_SLAVES];
+module_param_array(aux_reg, ushort, NULL, 0444);
+MODULE_PARM_DESC(aux_reg, "first data register of each auxiliary slave");
+
+static unsigned short aux_len[MPU6050_AUX_SLAVES];
+module_param_array(aux_len, ushort, NULL, 0444);
+MODULE_PARM_DESC(aux_len, "bytes to read from each auxiliary slave (1..15)");
+
+static bool aux_swap[MPU6050_AUX_SLAVES];
+module_param_array(aux_swap, bool, NULL, 0444);
+MODULE_PARM_DESC(aux_swap, "swap bytes of 16-bit words of each slave (little-endian slaves)");
+
+static unsigned short aux_init_reg[8];
+static int aux_init_num;
+module_param_array(aux_init_reg, ushort, &aux_init_num, 0444);
+MODULE_PARM_DESC(aux_init_reg, "registers of slot 0 slave written at probe");
+
+static unsigned short aux_init_val[8];
+static int aux_init_val_num;
+module_param_array(aux_init_val, ushort, &aux_init_val_num, 0444);
+MODULE_PARM_DESC(aux_init_val, "values for aux_init_reg");
+
+static unsigned int poll_ms = 10;
+module_param(poll_ms, uint, 0444);
+MODULE_PARM_DESC(poll_ms, "acquisition period in ms for /dev/mpu6050, 0 - disabled");
 
 
 struct mpu6050_data {
 	struct i2c_client *drv_client;
 	int accel_values[3];
 	int gyro_values[3];
+	int mag_values[3];
 	int temperature;
+	int ext_len;
+	struct mpu6050_sample sample;
 };
 
 static struct mpu6050_data g_mpu6050_data;
 
-static int mpu6050_read_data(void)
+/* Magnetometer is expected in the first 6 bytes of slot 0 */
+static bool mpu6050_has_mag(void)
 {
-	int temp;
-	struct i2c_client *drv_client = g_mpu6050_data.drv_client;
-
-	if (drv_client == 0)
-		return -ENODEV;
-
-	/* accel */
-	g_mpu6050_data.accel_values[0] = (s16)((u16)i2c_smbus_read_word_swapped(drv_client, REG_ACCEL_XOUT_H));
-	g_mpu6050_data.accel_values[1] = (s16)((u16)i2c_smbus_read_word_swapped(drv_client, REG_ACCEL_YOUT_H));
-	g_mpu6050_data.accel_values[2] = (s16)((u16)i2c_smbus_read_word_swapped(drv_client, REG_ACCEL_ZOUT_H));
-	/* gyro */
-	g_mpu6050_data.gyro_values[0] = (s16)((u16)i2c_smbus_read_word_swapped(drv_client, REG_GYRO_XOUT_H));
-	g_mpu6050_data.gyro_values[1] = (s16)((u16)i2c_smbus_read_word_swapped(drv_client, REG_GYRO_YOUT_H));
-	g_mpu6050_data.gyro_values[2] = (s16)((u16)i2c_smbus_read_word_swapped(drv_client, REG_GYRO_ZOUT_H));
-	/* Temperature in degrees C =
-	 * (TEMP_OUT Register Value  as a signed quantity)/340 + 36.53
-	 */
-	temp = (s16)((u16)i2c_smbus_read_word_swapped(drv_client, REG_TEMP_OUT_H));
-	g_mpu6050_data.temperature = (temp + 12420 + 170) / 340;
-
-	dev_info(&drv_client->dev, "sensor data read:\n");
-	dev_info(&drv_client->dev, "ACCEL[X,Y,Z] = [%d, %d, %d]\n",
+	return aux_addr_num > 0 && aux_len[0] >= 6;
+}
+
+/* Serializes bus access and the ring producer */
+static DEFINE_MUTEX(mpu6050_lock);
+
+/* Every acquired sample goes here, /dev/mpu6050 readers follow it */
+static struct mpu6050_ring g_mpu6050_ring;
+static DECLARE_WAIT_QUEUE_HEAD(mpu6050_wq);
+
+/*
+ * The sensor is polled only while /dev/mpu6050 is open: the first open
+ * starts the work, the last release stops it.
+ */
+static void mpu6050_poll_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(mpu6050_poll, mpu6050_poll_work);
+static DEFINE_MUTEX(mpu6050_users_lock);
+static unsigned int mpu6050_users;
+
+/* Read len bytes starting from ACCEL_XOUT_H in one I2C transaction */
+static int mpu6050_read_burst(struct i2c_client *drv_client, u8 *raw, int len)
+{
+	u8 reg = REG_ACCEL_XOUT_H;
+	struct i2c_msg msgs[] = {
+		{
+			.addr = drv_client->addr,
+			.flags = 0,
+			.len = 1,
+			.buf = &reg,
+		},
+		{
+			.addr = drv_client->addr,
+			.flags = I2C_M_RD,
+			.len = len,
+			.buf = raw,
+		},
+	};
+	int ret;
+
+	ret = i2c_transfer(drv_client->adapter, msgs, ARRAY_SIZE(msgs));
+	if (ret < 0)
+		return ret;
+	if (ret != ARRAY_SIZE(msgs))
+		return -EIO;
+	return 0;
+}
+
+/*
+ * Reads one sample into g_mpu6050_data and, if out is given, a copy of it
+ * taken under the lock. Only the poll work feeds the ring: samples taken
+ * on behalf of sysfs readers would give /dev readers an irregular
+ * sampling rate.
+ */
+static int mpu6050_read_data(bool to_ring, struct mpu6050_sample *out)
+{
+	int i, ret;
+	u8 raw[MPU6050_BURST_LEN + MPU6050_EXT_SENS_MAX];
+	struct mpu6050_sample *sample = &g_mpu6050_data.sample;
+	struct i2c_client *drv_client;
+
+	mutex_lock(&mpu6050_lock);
+
+	drv_client = g_mpu6050_data.drv_client;
+	if (drv_client == 0) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	ret = mpu6050_read_burst(drv_client, raw,
+				 MPU6050_BURST_LEN + g_mpu6050_data.ext_len);
+	if (ret) {
+		dev_err_ratelimited(&drv_client->dev, "burst read failed: %d\n",
+				    ret);
+		goto out;
+	}
+	sample->timestamp = ktime_get_ns();
+	mpu6050_decode(raw, g_mpu6050_data.ext_len, sample);
+
+	for (i = 0; i < 3; i++) {
+		g_mpu6050_data.accel_values[i] = sample->accel[i];
+		g_mpu6050_data.gyro_values[i] = sample->gyro[i];
+		if (sample->ext_len && mpu6050_has_mag())
+			g_mpu6050_data.mag_values[i] =
+				mpu6050_be16(&sample->ext[2 * i]);
+	}
+	g_mpu6050_data.temperature = mpu6050_temp_celsius(sample->temp);
+
+	if (out)
+		*out = *sample;
+	if (to_ring) {
+		mpu6050_ring_push(&g_mpu6050_ring, sample);
+		wake_up_interruptible(&mpu6050_wq);
+	}
+
+	/* Called every poll_ms, keep the dump out of the log by default */
+	dev_dbg(&drv_client->dev, "sensor data read:\n");
+	dev_dbg(&drv_client->dev, "ACCEL[X,Y,Z] = [%d, %d, %d]\n",
 		g_mpu6050_data.accel_values[0],
 		g_mpu6050_data.accel_values[1],
 		g_mpu6050_data.accel_values[2]);
-	dev_info(&drv_client->dev, "GYRO[X,Y,Z] = [%d, %d, %d]\n",
+	dev_dbg(&drv_client->dev, "GYRO[X,Y,Z] = [%d, %d, %d]\n",
 		g_mpu6050_data.gyro_values[0],
 		g_mpu6050_data.gyro_values[1],
 		g_mpu6050_data.gyro_values[2]);
-	dev_info(&drv_client->dev, "TEMP = %d\n",
+	if (sample->ext_len && mpu6050_has_mag())
+		dev_dbg(&drv_client->dev, "MAG[X,Y,Z] = [%d, %d, %d]\n",
+			g_mpu6050_data.mag_values[0],
+			g_mpu6050_data.mag_values[1],
+			g_mpu6050_data.mag_values[2]);
+	dev_dbg(&drv_client->dev, "TEMP = %d\n",
 		g_mpu6050_data.temperature);
 
+out:
+	mutex_unlock(&mpu6050_lock);
+	return ret;
+}
+
+static void mpu6050_poll_work(struct work_struct *work)
+{
+	/* No device bound, probe restarts polling if there are readers */
+	if (mpu6050_read_data(true, NULL) == -ENODEV)
+		return;
+	schedule_delayed_work(&mpu6050_poll, msecs_to_jiffies(poll_ms));
+}
+
+/* Single byte write to the slot 0 slave through the SLV4 channel */
+static int mpu6050_aux_write(struct i2c_client *drv_client, u8 reg, u8 val)
+{
+	int ret, retries = 10;
+
+	i2c_smbus_write_byte_data(drv_client, REG_I2C_SLV4_ADDR, aux_addr[0]);
+	i2c_smbus_write_byte_data(drv_client, REG_I2C_SLV4_REG, reg);
+	i2c_smbus_write_byte_data(drv_client, REG_I2C_SLV4_DO, val);
+	i2c_smbus_write_byte_data(drv_client, REG_I2C_SLV4_CTRL, I2C_SLV_EN);
+
+	do {
+		usleep_range(1000, 2000);
+		ret = i2c_smbus_read_byte_data(drv_client, REG_I2C_MST_STATUS);
+		if (ret < 0)
+			return ret;
+		if (ret & I2C_MST_SLV4_NACK)
+			return -ENXIO;
+	} while (!(ret & I2C_MST_SLV4_DONE) && --retries);
+
+	return retries ? 0 : -ETIMEDOUT;
+}
+
+/* Enable I2C master and program SLV0..SLV3 from module parameters */
+static int mpu6050_setup_aux(struct i2c_client *drv_client)
+{
+	int i, ret;
+	int ext_len = 0;
+	u8 ctrl;
+
+	g_mpu6050_data.ext_len = 0;
+	if (aux_addr_num == 0)
+		return 0;
+
+	/* Parameters were checked at load time */
+	for (i = 0; i < aux_addr_num; i++)
+		ext_len += aux_len[i];
+
+	/* Data ready is delayed until external sensor data is loaded */
+	i2c_smbus_write_byte_data(drv_client, REG_I2C_MST_CTRL,
+				  I2C_MST_WAIT_FOR_ES | I2C_MST_CLK_400KHZ);
+	i2c_smbus_write_byte_data(drv_client, REG_USER_CTRL,
+				  USER_CTRL_I2C_MST_EN);
+
+	for (i = 0; i < aux_init_num; i++) {
+		ret = mpu6050_aux_write(drv_client, aux_init_reg[i],
+					aux_init_val[i]);
+		if (ret) {
+			dev_err(&drv_client->dev,
+				"aux slave 0x%X init write failed: %d\n",
+				aux_addr[0], ret);
+			goto err_mst;
+		}
+	}
+
+	for (i = 0; i < aux_addr_num; i++) {
+		ctrl = I2C_SLV_EN | aux_len[i];
+		if (aux_swap[i])
+			ctrl |= I2C_SLV_BYTE_SW;
+		/* Odd start register: swap pairs starting from the first byte */
+		if (aux_swap[i] && (aux_reg[i] & 1))
+			ctrl |= I2C_SLV_GRP;
+		i2c_smbus_write_byte_data(drv_client, REG_I2C_SLV_ADDR(i),
+					  I2C_SLV_RNW | aux_addr[i]);
+		i2c_smbus_write_byte_data(drv_client, REG_I2C_SLV_REG(i),
+					  aux_reg[i]);
+		i2c_smbus_write_byte_data(drv_client, REG_I2C_SLV_CTRL(i), ctrl);
+		dev_info(&drv_client->dev,
+			"aux slave %d: addr 0x%X, reg 0x%X, len %u\n",
+			i, aux_addr[i], aux_reg[i], aux_len[i]);
+	}
+
+	g_mpu6050_data.ext_len = ext_len;
+	return 0;
+
+err_mst:
+	i2c_smbus_write_byte_data(drv_client, REG_USER_CTRL, 0);
+	i2c_smbus_write_byte_data(drv_client, REG_I2C_MST_CTRL, 0);
+	return ret;
+}
+
+/* Reject aux parameters which would be truncated or overflow EXT_SENS_DATA */
+static int mpu6050_check_params(void)
+{
+	int i, ext_len = 0;
+
+	if (aux_init_val_num != aux_init_num) {
+		pr_err("mpu6050: %d aux_init_reg but %d aux_init_val given\n",
+		       aux_init_num, aux_init_val_num);
+		return -EINVAL;
+	}
+	for (i = 0; i < aux_init_num; i++) {
+		if (aux_init_reg[i] > 0xff || aux_init_val[i] > 0xff) {
+			pr_err("mpu6050: invalid aux_init pair %d: 0x%X 0x%X\n",
+			       i, aux_init_reg[i], aux_init_val[i]);
+			return -EINVAL;
+		}
+	}
+
+	for (i = 0; i < aux_addr_num; i++) {
+		if (aux_addr[i] > 0x7f) {
+			pr_err("mpu6050: invalid aux_addr 0x%X for slave %d\n",
+			       aux_addr[i], i);
+			return -EINVAL;
+		}
+		if (aux_reg[i] > 0xff) {
+			pr_err("mpu6050: invalid aux_reg 0x%X for slave %d\n",
+			       aux_reg[i], i);
+			return -EINVAL;
+		}
+		if (aux_len[i] == 0 || aux_len[i] > I2C_SLV_LEN_MAX ||
+		    ext_len + aux_len[i] > MPU6050_EXT_SENS_MAX) {
+			pr_err("mpu6050: invalid aux_len %u for slave %d\n",
+			       aux_len[i], i);
+			return -EINVAL;
+		}
+		ext_len += aux_len[i];
+	}
 	return 0;
 }
 
@@ -92,7 +359,18 @@ static int mpu6050_probe(struct i2c_client *drv_client,
 	i2c_smbus_write_byte_data(drv_client, REG_PWR_MGMT_1, 0);
 	i2c_smbus_write_byte_data(drv_client, REG_PWR_MGMT_2, 0);
 
+	ret = mpu6050_setup_aux(drv_client);
+	if (ret)
+		return ret;
+
+	mutex_lock(&mpu6050_lock);
 	g_mpu6050_data.drv_client = drv_client;
+	mutex_unlock(&mpu6050_lock);
+
+	mutex_lock(&mpu6050_users_lock);
+	if (poll_ms && mpu6050_users)
+		schedule_delayed_work(&mpu6050_poll, 0);
+	mutex_unlock(&mpu6050_users_lock);
 
 	dev_info(&drv_client->dev, "i2c driver probed\n");
 	return 0;
@@ -100,12 +378,145 @@ static int mpu6050_probe(struct i2c_client *drv_client,
 
 static int mpu6050_remove(struct i2c_client *drv_client)
 {
+	mutex_lock(&mpu6050_users_lock);
+	cancel_delayed_work_sync(&mpu6050_poll);
+	mutex_unlock(&mpu6050_users_lock);
+
+	mutex_lock(&mpu6050_lock);
 	g_mpu6050_data.drv_client = 0;
+	mutex_unlock(&mpu6050_lock);
 
 	dev_info(&drv_client->dev, "i2c driver removed\n");
 	return 0;
 }
 
+/* Per open file state of /dev/mpu6050: an own cursor into the shared ring */
+struct mpu6050_reader {
+	struct mutex lock;
+	unsigned int cursor;
+	bool overrun;
+};
+
+static int mpu6050_dev_open(struct inode *inode, struct file *file)
+{
+	struct mpu6050_reader *reader;
+
+	reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+	if (reader == NULL)
+		return -ENOMEM;
+
+	mutex_init(&reader->lock);
+	/* New readers start with the next acquired sample */
+	reader->cursor = smp_load_acquire(&g_mpu6050_ring.head);
+	file->private_data = reader;
+
+	mutex_lock(&mpu6050_users_lock);
+	if (mpu6050_users++ == 0 && poll_ms)
+		schedule_delayed_work(&mpu6050_poll, 0);
+	mutex_unlock(&mpu6050_users_lock);
+
+	return nonseekable_open(inode, file);
+}
+
+static int mpu6050_dev_release(struct inode *inode, struct file *file)
+{
+	mutex_lock(&mpu6050_users_lock);
+	if (--mpu6050_users == 0)
+		cancel_delayed_work_sync(&mpu6050_poll);
+	mutex_unlock(&mpu6050_users_lock);
+
+	kfree(file->private_data);
+	return 0;
+}
+
+/*
+ * Returns whole struct mpu6050_sample records.
+ * If the reader was lapped by the producer, -EOVERFLOW is returned once
+ * and reading continues from the oldest sample still in the ring.
+ * With poll_ms=0 nothing feeds the ring and read() fails with -EAGAIN
+ * instead of blocking.
+ */
+static ssize_t mpu6050_dev_read(struct file *file, char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct mpu6050_reader *reader = file->private_data;
+	struct mpu6050_sample sample;
+	size_t done = 0;
+	int ret;
+
+	if (count < sizeof(sample))
+		return -EINVAL;
+
+	if (mutex_lock_interruptible(&reader->lock))
+		return -ERESTARTSYS;
+
+	if (reader->overrun) {
+		reader->overrun = false;
+		ret = -EOVERFLOW;
+		goto out;
+	}
+
+	while (done + sizeof(sample) <= count) {
+		ret = mpu6050_ring_read(&g_mpu6050_ring, &reader->cursor,
+					&sample);
+		if (ret == -EOVERFLOW) {
+			/* Deliver what was read before the gap first */
+			if (done)
+				reader->overrun = true;
+			break;
+		}
+		if (ret == -EAGAIN) {
+			if (done)
+				break;
+			/* Without polling nothing would ever wake us up */
+			if ((file->f_flags & O_NONBLOCK) || poll_ms == 0)
+				break;
+			ret = wait_event_interruptible(mpu6050_wq,
+				!mpu6050_ring_empty(&g_mpu6050_ring,
+						    reader->cursor));
+			if (ret)
+				break;
+			continue;
+		}
+		if (copy_to_user(buf + done, &sample, sizeof(sample))) {
+			ret = -EFAULT;
+			break;
+		}
+		done += sizeof(sample);
+	}
+
+out:
+	mutex_unlock(&reader->lock);
+	return done ? done : ret;
+}
+
+static unsigned int mpu6050_dev_poll(struct file *file, poll_table *wait)
+{
+	struct mpu6050_reader *reader = file->private_data;
+
+	poll_wait(file, &mpu6050_wq, wait);
+
+	if (READ_ONCE(reader->overrun) ||
+	    !mpu6050_ring_empty(&g_mpu6050_ring, READ_ONCE(reader->cursor)))
+		return POLLIN | POLLRDNORM;
+	return 0;
+}
+
+static const struct file_operations mpu6050_fops = {
+	.owner = THIS_MODULE,
+	.open = mpu6050_dev_open,
+	.release = mpu6050_dev_release,
+	.read = mpu6050_dev_read,
+	.poll = mpu6050_dev_poll,
+	.llseek = no_llseek,
+};
+
+static struct miscdevice mpu6050_miscdev = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "mpu6050",
+	.fops = &mpu6050_fops,
+};
+
 static const struct i2c_device_id mpu6050_idtable[] = {
 	{ "mpu6050", 0 },
 	{ }
@@ -125,7 +536,7 @@ static struct i2c_driver mpu6050_i2c_driver = {
 static ssize_t accel_x_show(struct class *class,
 			    struct class_attribute *attr, char *buf)
 {
-	mpu6050_read_data();
+	mpu6050_read_data(false, NULL);
 
 	sprintf(buf, "%d\n", g_mpu6050_data.accel_values[0]);
 	return strlen(buf);
@@ -134,7 +545,7 @@ static ssize_t accel_x_show(struct class *class,
 static ssize_t accel_y_show(struct class *class,
 			    struct class_attribute *attr, char *buf)
 {
-	mpu6050_read_data();
+	mpu6050_read_data(false, NULL);
 
 	sprintf(buf, "%d\n", g_mpu6050_data.accel_values[1]);
 	return strlen(buf);
@@ -143,7 +554,7 @@ static ssize_t accel_y_show(struct class *class,
 static ssize_t accel_z_show(struct class *class,
 			    struct class_attribute *attr, char *buf)
 {
-	mpu6050_read_data();
+	mpu6050_read_data(false, NULL);
 
 	sprintf(buf, "%d\n", g_mpu6050_data.accel_values[2]);
 	return strlen(buf);
@@ -152,7 +563,7 @@ static ssize_t accel_z_show(struct class *class,
 static ssize_t gyro_x_show(struct class *class,
 			   struct class_attribute *attr, char *buf)
 {
-	mpu6050_read_data();
+	mpu6050_read_data(false, NULL);
 
 	sprintf(buf, "%d\n", g_mpu6050_data.gyro_values[0]);
 	return strlen(buf);
@@ -161,7 +572,7 @@ static ssize_t gyro_x_show(struct class *class,
 static ssize_t gyro_y_show(struct class *class,
 			   struct class_attribute *attr, char *buf)
 {
-	mpu6050_read_data();
+	mpu6050_read_data(false, NULL);
 
 	sprintf(buf, "%d\n", g_mpu6050_data.gyro_values[1]);
 	return strlen(buf);
@@ -170,34 +581,122 @@ static ssize_t gyro_y_show(struct class *class,
 static ssize_t gyro_z_show(struct class *class,
 			   struct class_attribute *attr, char *buf)
 {
-	mpu6050_read_data();
+	mpu6050_read_data(false, NULL);
 
 	sprintf(buf, "%d\n", g_mpu6050_data.gyro_values[2]);
 	return strlen(buf);
 }
 
+static ssize_t mag_show(int axis, char *buf)
+{
+	mpu6050_read_data(false, NULL);
+
+	if (!g_mpu6050_data.ext_len || !mpu6050_has_mag())
+		return -ENODATA;
+	sprintf(buf, "%d\n", g_mpu6050_data.mag_values[axis]);
+	return strlen(buf);
+}
+
+static ssize_t mag_x_show(struct class *class,
+			  struct class_attribute *attr, char *buf)
+{
+	return mag_show(0, buf);
+}
+
+static ssize_t mag_y_show(struct class *class,
+			  struct class_attribute *attr, char *buf)
+{
+	return mag_show(1, buf);
+}
+
+static ssize_t mag_z_show(struct class *class,
+			  struct class_attribute *attr, char *buf)
+{
+	return mag_show(2, buf);
+}
+
 static ssize_t temp_show(struct class *class,
 			 struct class_attribute *attr, char *buf)
 {
-	mpu6050_read_data();
+	mpu6050_read_data(false, NULL);
 
 	sprintf(buf, "%d\n", g_mpu6050_data.temperature);
 	return strlen(buf);
 }
 
+/*
+ * All values of one burst in a single line, so that they belong together:
+ * "timestamp accel_x accel_y accel_z gyro_x gyro_y gyro_z temperature"
+ * followed by "mag_x mag_y mag_z" when slot 0 provides them. Units are
+ * those of the single attributes, the timestamp is ktime_get_ns().
+ */
+static ssize_t sample_show(struct class *class,
+			   struct class_attribute *attr, char *buf)
+{
+	struct mpu6050_sample sample;
+	int len, ret;
+
+	ret = mpu6050_read_data(false, &sample);
+	if (ret)
+		return ret;
+
+	len = sprintf(buf, "%llu %d %d %d %d %d %d %d",
+		      (unsigned long long)sample.timestamp,
+		      sample.accel[0], sample.accel[1], sample.accel[2],
+		      sample.gyro[0], sample.gyro[1], sample.gyro[2],
+		      mpu6050_temp_celsius(sample.temp));
+	if (sample.ext_len && mpu6050_has_mag())
+		len += sprintf(buf + len, " %d %d %d",
+			       mpu6050_be16(&sample.ext[0]),
+			       mpu6050_be16(&sample.ext[2]),
+			       mpu6050_be16(&sample.ext[4]));
+	len += sprintf(buf + len, "\n");
+	return len;
+}
+
 CLASS_ATTR(accel_x, 0444, &accel_x_show, NULL);
 CLASS_ATTR(accel_y, 0444, &accel_y_show, NULL);
 CLASS_ATTR(accel_z, 0444, &accel_z_show, NULL);
 CLASS_ATTR(gyro_x, 0444, &gyro_x_show, NULL);
 CLASS_ATTR(gyro_y, 0444, &gyro_y_show, NULL);
 CLASS_ATTR(gyro_z, 0444, &gyro_z_show, NULL);
+CLASS_ATTR(mag_x, 0444, &mag_x_show, NULL);
+CLASS_ATTR(mag_y, 0444, &mag_y_show, NULL);
+CLASS_ATTR(mag_z, 0444, &mag_z_show, NULL);
 CLASS_ATTR(temperature, 0444, &temp_show, NULL);
+CLASS_ATTR(sample, 0444, &sample_show, NULL);
+
+static struct class_attribute *mpu6050_attrs[] = {
+	&class_attr_accel_x,
+	&class_attr_accel_y,
+	&class_attr_accel_z,
+	&class_attr_gyro_x,
+	&class_attr_gyro_y,
+	&class_attr_gyro_z,
+	&class_attr_mag_x,
+	&class_attr_mag_y,
+	&class_attr_mag_z,
+	&class_attr_temperature,
+	&class_attr_sample,
+};
 
 static struct class *attr_class;
 
+static void mpu6050_remove_attrs(int num)
+{
+	while (num--)
+		class_remove_file(attr_class, mpu6050_attrs[num]);
+}
+
 static int mpu6050_init(void)
 {
-	int ret;
+	int i, ret;
+
+	ret = mpu6050_check_params();
+	if (ret)
+		return ret;
+
+	mpu6050_ring_init(&g_mpu6050_ring);
 
 	/* Create i2c driver */
 	ret = i2c_add_driver(&mpu6050_i2c_driver);
@@ -207,79 +706,57 @@ static int mpu6050_init(void)
 	}
 	pr_info("mpu6050: i2c driver created\n");
 
+	/* Create sample stream device */
+	ret = misc_register(&mpu6050_miscdev);
+	if (ret) {
+		pr_err("mpu6050: failed to register misc device: %d\n", ret);
+		goto err_driver;
+	}
+	pr_info("mpu6050: /dev/%s created\n", mpu6050_miscdev.name);
+
 	/* Create class */
 	attr_class = class_create(THIS_MODULE, "mpu6050");
 	if (IS_ERR(attr_class)) {
 		ret = PTR_ERR(attr_class);
 		pr_err("mpu6050: failed to create sysfs class: %d\n", ret);
-		return ret;
+		goto err_misc;
 	}
 	pr_info("mpu6050: sysfs class created\n");
 
-	/* Create accel_x */
-	ret = class_create_file(attr_class, &class_attr_accel_x);
-	if (ret) {
-		pr_err("mpu6050: failed to create sysfs class attribute accel_x: %d\n", ret);
-		return ret;
-	}
-	/* Create accel_y */
-	ret = class_create_file(attr_class, &class_attr_accel_y);
-	if (ret) {
-		pr_err("mpu6050: failed to create sysfs class attribute accel_y: %d\n", ret);
-		return ret;
-	}
-	/* Create accel_z */
-	ret = class_create_file(attr_class, &class_attr_accel_z);
-	if (ret) {
-		pr_err("mpu6050: failed to create sysfs class attribute accel_z: %d\n", ret);
-		return ret;
+	/* Create class attributes */
+	for (i = 0; i < ARRAY_SIZE(mpu6050_attrs); i++) {
+		ret = class_create_file(attr_class, mpu6050_attrs[i]);
+		if (ret) {
+			pr_err("mpu6050: failed to create sysfs class attribute %s: %d\n",
+			       mpu6050_attrs[i]->attr.name, ret);
+			goto err_attrs;
+		}
 	}
-	/* Create gyro_x */
-	ret = class_create_file(attr_class, &class_attr_gyro_x);
-	if (ret) {
-		pr_err("mpu6050: failed to create sysfs class attribute gyro_x: %d\n", ret);
-		return ret;
-	}
-	/* Create gyro_y */
-	ret = class_create_file(attr_class, &class_attr_gyro_y);
-	if (ret) {
-		pr_err("mpu6050: failed to create sysfs class attribute gyro_y: %d\n", ret);
-		return ret;
-	}
-	/* Create gyro_z */
-	ret = class_create_file(attr_class, &class_attr_gyro_z);
-	if (ret) {
-		pr_err("mpu6050: failed to create sysfs class attribute gyro_z: %d\n", ret);
-		return ret;
-	}
-	/* Create temperature */
-	ret = class_create_file(attr_class, &class_attr_temperature);
-	if (ret) {
-		pr_err("mpu6050: failed to create sysfs class attribute temperature: %d\n", ret);
-		return ret;
-	}
-
 	pr_info("mpu6050: sysfs class attributes created\n");
 
 	pr_info("mpu6050: module loaded\n");
 	return 0;
+
+err_attrs:
+	mpu6050_remove_attrs(i);
+	class_destroy(attr_class);
+err_misc:
+	misc_deregister(&mpu6050_miscdev);
+err_driver:
+	i2c_del_driver(&mpu6050_i2c_driver);
+	return ret;
 }
 
 static void mpu6050_exit(void)
 {
-	if (attr_class) {
-		class_remove_file(attr_class, &class_attr_accel_x);
-		class_remove_file(attr_class, &class_attr_accel_y);
-		class_remove_file(attr_class, &class_attr_accel_z);
-		class_remove_file(attr_class, &class_attr_gyro_x);
-		class_remove_file(attr_class, &class_attr_gyro_y);
-		class_remove_file(attr_class, &class_attr_gyro_z);
-		class_remove_file(attr_class, &class_attr_temperature);
-		pr_info("mpu6050: sysfs class attributes removed\n");
-
-		class_destroy(attr_class);
-		pr_info("mpu6050: sysfs class destroyed\n");
-	}
+	mpu6050_remove_attrs(ARRAY_SIZE(mpu6050_attrs));
+	pr_info("mpu6050: sysfs class attributes removed\n");
+
+	class_destroy(attr_class);
+	pr_info("mpu6050: sysfs class destroyed\n");
+
+	misc_deregister(&mpu6050_miscdev);
+	pr_info("mpu6050: /dev/%s removed\n", mpu6050_miscdev.name);
 
 	i2c_del_driver(&mpu6050_i2c_driver);
 	pr_info("mpu6050: i2c driver deleted\n");
@@ -0,0 +1,201 @@
+/*
+ * Micro-benchmarks for the hardware independent parts of the driver:
+ * burst decoding, temperature conversion, scaling and the sample ring.
+ *
+ * Every result is also checked against a straightforward reference, so
+ * a faster hot path can be validated on the host before going to a board.
+ *
+ * usage: decodebench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#define READ_ONCE(x)		__atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define WRITE_ONCE(x, v)	__atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#define smp_load_acquire(p)	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define smp_wmb()		__atomic_thread_fence(__ATOMIC_RELEASE)
+#define smp_rmb()		__atomic_thread_fence(__ATOMIC_ACQUIRE)
+
+#include "mpu6050-data.h"
+#include "mpu6050-ring.h"
+
+#define RAW_SETS	1024
+
+static __u8 raw[RAW_SETS][MPU6050_BURST_LEN + MPU6050_EXT_SENS_MAX];
+static int failures;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#define CHECK(cond, ...)						\
+	do {								\
+		if (!(cond)) {						\
+			printf("FAIL: " __VA_ARGS__);			\
+			failures++;					\
+		}							\
+	} while (0)
+
+/* What i2c_smbus_read_word_swapped() based code used to produce */
+static int ref_word(const __u8 *p)
+{
+	return (__s16)(__u16)(p[0] * 256 + p[1]);
+}
+
+static void check_decode(void)
+{
+	struct mpu6050_sample s;
+	int n, i;
+
+	for (n = 0; n < RAW_SETS; n++) {
+		mpu6050_decode(raw[n], 6, &s);
+		for (i = 0; i < 3; i++) {
+			CHECK(s.accel[i] == ref_word(&raw[n][2 * i]),
+			      "accel[%d] of set %d\n", i, n);
+			CHECK(s.gyro[i] == ref_word(&raw[n][8 + 2 * i]),
+			      "gyro[%d] of set %d\n", i, n);
+		}
+		CHECK(s.temp == ref_word(&raw[n][6]), "temp of set %d\n", n);
+		CHECK(s.ext_len == 6 &&
+		      !memcmp(s.ext, &raw[n][MPU6050_BURST_LEN], 6),
+		      "ext of set %d\n", n);
+	}
+}
+
+static void check_conversions(void)
+{
+	int t;
+
+	/* Datasheet: T = TEMP_OUT / 340 + 36.53, rounded to nearest */
+	for (t = -32768; t <= 32767; t++) {
+		int c = mpu6050_temp_celsius(t);
+		double ref = t / 340.0 + 36.53;
+
+		CHECK(fabs(c - ref) <= 0.51, "temp %d -> %d (%.2f)\n", t, c, ref);
+	}
+	CHECK(mpu6050_accel_mg(16384) == 1000, "accel 1g\n");
+	CHECK(mpu6050_accel_mg(-32768) == -2000, "accel -2g\n");
+	CHECK(mpu6050_gyro_mdps(131) == 1000, "gyro 1 dps\n");
+	CHECK(mpu6050_gyro_mdps(-32768) == -250137, "gyro -250 dps\n");
+}
+
+static void check_ring(void)
+{
+	static struct mpu6050_ring ring;
+	struct mpu6050_sample s;
+	unsigned int cursor, i;
+
+	memset(&s, 0, sizeof(s));
+	mpu6050_ring_init(&ring);
+	cursor = ring.head;
+	CHECK(mpu6050_ring_read(&ring, &cursor, &s) == -EAGAIN, "empty ring\n");
+
+	for (i = 0; i < MPU6050_RING_SIZE; i++) {
+		s.timestamp = i;
+		mpu6050_ring_push(&ring, &s);
+	}
+	for (i = 0; i < MPU6050_RING_SIZE; i++)
+		CHECK(mpu6050_ring_read(&ring, &cursor, &s) == 0 &&
+		      s.timestamp == i, "ring read %u\n", i);
+
+	/* Lap the reader: one overrun, then the oldest remaining sample */
+	for (i = 0; i < MPU6050_RING_SIZE + 10; i++) {
+		s.timestamp = MPU6050_RING_SIZE + i;
+		mpu6050_ring_push(&ring, &s);
+	}
+	CHECK(mpu6050_ring_read(&ring, &cursor, &s) == -EOVERFLOW,
+	      "ring overrun not reported\n");
+	CHECK(mpu6050_ring_read(&ring, &cursor, &s) == 0 &&
+	      s.timestamp == ring.head - MPU6050_RING_SIZE + 1,
+	      "ring resume after overrun\n");
+}
+
+static volatile int sink;
+
+static void bench(long iters)
+{
+	static struct mpu6050_ring ring;
+	struct mpu6050_sample s;
+	unsigned int cursor;
+	double t0;
+	long n;
+	int acc = 0;
+
+	memset(&s, 0, sizeof(s));
+
+	t0 = now_ns();
+	for (n = 0; n < iters; n++) {
+		mpu6050_decode(raw[n & (RAW_SETS - 1)], 0, &s);
+		acc += s.accel[0] + s.gyro[2];
+	}
+	printf("%-24s %8.2f ns/sample\n", "decode",
+	       (now_ns() - t0) / iters);
+
+	t0 = now_ns();
+	for (n = 0; n < iters; n++) {
+		mpu6050_decode(raw[n & (RAW_SETS - 1)], 6, &s);
+		acc += s.accel[0] + s.ext[5];
+	}
+	printf("%-24s %8.2f ns/sample\n", "decode + 6 ext bytes",
+	       (now_ns() - t0) / iters);
+
+	t0 = now_ns();
+	for (n = 0; n < iters; n++) {
+		const __u8 *p = raw[n & (RAW_SETS - 1)];
+
+		acc += mpu6050_temp_celsius(mpu6050_be16(&p[6])) +
+		       mpu6050_accel_mg(mpu6050_be16(&p[0])) +
+		       mpu6050_gyro_mdps(mpu6050_be16(&p[8]));
+	}
+	printf("%-24s %8.2f ns/sample\n", "convert temp+accel+gyro",
+	       (now_ns() - t0) / iters);
+
+	mpu6050_ring_init(&ring);
+	cursor = ring.head;
+	t0 = now_ns();
+	for (n = 0; n < iters; n++) {
+		mpu6050_ring_push(&ring, &s);
+		acc += mpu6050_ring_read(&ring, &cursor, &s);
+	}
+	printf("%-24s %8.2f ns/sample\n", "ring push + read",
+	       (now_ns() - t0) / iters);
+
+	sink = acc;
+}
+
+int main(int argc, char *argv[])
+{
+	long iters = argc > 1 ? atol(argv[1]) : 10000000;
+	int n, i;
+
+	if (iters <= 0) {
+		fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	srand(1);
+	for (n = 0; n < RAW_SETS; n++)
+		for (i = 0; i < (int)sizeof(raw[n]); i++)
+			raw[n][i] = rand();
+
+	check_decode();
+	check_conversions();
+	check_ring();
+	if (failures) {
+		printf("%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("all checks passed\n");
+
+	bench(iters);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "mpu6050-data.h"
+#include "libmpu6050.h"
+
+#define DEV_PATH	"/dev/mpu6050"
+#define SAMPLE_PATH	"/sys/class/mpu6050/sample"
+#define POLL_MS_PATH	"/sys/module/mpu6050/parameters/poll_ms"
+#define AUX_LEN_PATH	"/sys/module/mpu6050/parameters/aux_len"
+
+/* Samples taken from /dev/mpu6050 per read() while catching up */
+#define DEV_BATCH	32
+
+struct mpu6050 {
+	enum mpu6050_method method;
+	int dev_fd;
+	int sample_fd;
+	int slot0_len;		/* bytes of slot 0 in ext[], mag needs 6 */
+};
+
+static const char * const method_names[] = {
+	[MPU6050_AUTO] = "auto",
+	[MPU6050_DEV] = "dev",
+	[MPU6050_SYSFS] = "sysfs",
+	[MPU6050_SYSFS_REOPEN] = "sysfs-reopen",
+};
+
+const char *mpu6050_method_name(enum mpu6050_method method)
+{
+	if ((unsigned int)method >= sizeof(method_names) / sizeof(method_names[0]))
+		return "unknown";
+	return method_names[method];
+}
+
+enum mpu6050_method mpu6050_method(const struct mpu6050 *dev)
+{
+	return dev->method;
+}
+
+static int sysfs_open(struct mpu6050 *dev)
+{
+	dev->sample_fd = open(SAMPLE_PATH, O_RDONLY | O_CLOEXEC);
+	if (dev->sample_fd < 0)
+		return -1;
+
+	/* Reopen mode only needs to know that the attribute exists */
+	if (dev->method == MPU6050_SYSFS_REOPEN) {
+		close(dev->sample_fd);
+		dev->sample_fd = -1;
+	}
+	return 0;
+}
+
+/* First number of a module parameter, def if it cannot be read */
+static unsigned long param_read(const char *path, unsigned long def)
+{
+	char buf[64];
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return def;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return def;
+	buf[len] = '\0';
+	return strtoul(buf, NULL, 10);
+}
+
+/*
+ * /dev/mpu6050 only delivers samples when the driver polls the sensor,
+ * with poll_ms=0 its reads would never return data. Assume polling when
+ * the parameter cannot be read, the open of the node decides then.
+ */
+static int dev_polling(void)
+{
+	return param_read(POLL_MS_PATH, 1) != 0;
+}
+
+struct mpu6050 *mpu6050_open(enum mpu6050_method method)
+{
+	struct mpu6050 *dev;
+	int err;
+
+	dev = calloc(1, sizeof(*dev));
+	if (dev == NULL)
+		return NULL;
+	dev->dev_fd = -1;
+	dev->sample_fd = -1;
+
+	if (method == MPU6050_AUTO && !dev_polling())
+		method = MPU6050_SYSFS;
+
+	if (method == MPU6050_AUTO || method == MPU6050_DEV) {
+		/* Non-blocking, dev_read() drains the queue to the newest */
+		dev->dev_fd = open(DEV_PATH, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		if (dev->dev_fd >= 0) {
+			/* Without the parameter trust ext_len alone */
+			dev->slot0_len = param_read(AUX_LEN_PATH, 6);
+			dev->method = MPU6050_DEV;
+			return dev;
+		}
+		if (method == MPU6050_DEV)
+			goto error;
+		method = MPU6050_SYSFS;
+	}
+
+	dev->method = method;
+	if (sysfs_open(dev) == 0)
+		return dev;
+
+error:
+	err = errno;
+	mpu6050_close(dev);
+	errno = err;
+	return NULL;
+}
+
+void mpu6050_close(struct mpu6050 *dev)
+{
+	if (dev == NULL)
+		return;
+	if (dev->dev_fd >= 0)
+		close(dev->dev_fd);
+	if (dev->sample_fd >= 0)
+		close(dev->sample_fd);
+	free(dev);
+}
+
+/*
+ * The ring hands out samples oldest first, so drain it and keep the last
+ * one, that is the latest value. Only when nothing is queued wait for the
+ * next sample.
+ */
+static int dev_read(struct mpu6050 *dev, struct mpu6050_values *values)
+{
+	struct mpu6050_sample batch[DEV_BATCH], sample;
+	struct pollfd pfd = { .fd = dev->dev_fd, .events = POLLIN };
+	int got = 0, i, has_mag;
+	ssize_t len;
+
+	for (;;) {
+		len = read(dev->dev_fd, batch, sizeof(batch));
+		if (len > 0 && len % sizeof(sample) == 0) {
+			sample = batch[len / sizeof(sample) - 1];
+			got = 1;
+			continue;
+		}
+		/* Missed samples are not an error for a "latest value" API */
+		if (len < 0 && errno == EOVERFLOW)
+			continue;
+		if (len < 0 && errno == EAGAIN) {
+			if (got)
+				break;
+			if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+				return -1;
+			continue;
+		}
+		if (len >= 0)
+			errno = EIO;
+		return -1;
+	}
+
+	has_mag = sample.ext_len >= 6 && dev->slot0_len >= 6;
+	values->timestamp = sample.timestamp;
+	for (i = 0; i < 3; i++) {
+		values->accel[i] = sample.accel[i];
+		values->gyro[i] = sample.gyro[i];
+		if (has_mag)
+			values->mag[i] = mpu6050_be16(&sample.ext[2 * i]);
+	}
+	values->has_mag = has_mag;
+	values->temperature = mpu6050_temp_celsius(sample.temp);
+	return 0;
+}
+
+/*
+ * One read of the sample attribute, which the driver fills from a single
+ * burst, so all values belong to the same moment. mag_* follow only when
+ * an auxiliary slave provides them.
+ */
+static int sysfs_read(struct mpu6050 *dev, struct mpu6050_values *values)
+{
+	unsigned long long timestamp;
+	char buf[128];
+	ssize_t len;
+	int fd = dev->sample_fd, n;
+
+	if (dev->method == MPU6050_SYSFS_REOPEN) {
+		fd = open(SAMPLE_PATH, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return -1;
+		len = read(fd, buf, sizeof(buf) - 1);
+		close(fd);
+	} else {
+		len = pread(fd, buf, sizeof(buf) - 1, 0);
+	}
+	if (len <= 0) {
+		if (len == 0)
+			errno = EIO;
+		return -1;
+	}
+	buf[len] = '\0';
+
+	n = sscanf(buf, "%llu %d %d %d %d %d %d %d %d %d %d", &timestamp,
+		   &values->accel[0], &values->accel[1], &values->accel[2],
+		   &values->gyro[0], &values->gyro[1], &values->gyro[2],
+		   &values->temperature,
+		   &values->mag[0], &values->mag[1], &values->mag[2]);
+	if (n != 8 && n != 11) {
+		errno = EIO;
+		return -1;
+	}
+	values->timestamp = timestamp;
+	values->has_mag = n == 11;
+	return 0;
+}
+
+int mpu6050_read(struct mpu6050 *dev, struct mpu6050_values *values)
+{
+	memset(values, 0, sizeof(*values));
+	if (dev->method == MPU6050_DEV)
+		return dev_read(dev, values);
+	return sysfs_read(dev, values);
+}
@@ -0,0 +1,36 @@
+#ifndef _LIBMPU6050_H
+#define _LIBMPU6050_H
+
+#include <stdint.h>
+
+/*
+ * Userspace access to the mpu6050 driver.
+ * Files are opened once in mpu6050_open() and re-read in place, so a
+ * sample costs only the read syscalls themselves.
+ */
+
+enum mpu6050_method {
+	MPU6050_AUTO,		/* DEV if the driver polls, SYSFS otherwise */
+	MPU6050_DEV,		/* struct mpu6050_sample from /dev/mpu6050 */
+	MPU6050_SYSFS,		/* sample attribute, pread() on a kept fd */
+	MPU6050_SYSFS_REOPEN,	/* sample attribute, open/read/close */
+};
+
+struct mpu6050_values {
+	uint64_t timestamp;	/* ns, CLOCK_MONOTONIC, taken by the driver */
+	int accel[3];
+	int gyro[3];
+	int mag[3];
+	int has_mag;
+	int temperature;	/* degrees C */
+};
+
+struct mpu6050;
+
+struct mpu6050 *mpu6050_open(enum mpu6050_method method);
+enum mpu6050_method mpu6050_method(const struct mpu6050 *dev);
+const char *mpu6050_method_name(enum mpu6050_method method);
+int mpu6050_read(struct mpu6050 *dev, struct mpu6050_values *values);
+void mpu6050_close(struct mpu6050 *dev);
+
+#endif /* _LIBMPU6050_H */
@@ -0,0 +1,148 @@
+/*
+ * mpu6050 command line client.
+ *
+ * usage: mpu6050ctl [-m auto|dev|sysfs|sysfs-reopen] [-n samples]
+ *        mpu6050ctl -b seconds
+ *
+ * The benchmark mode runs every access method the loaded driver offers
+ * for the given time and reports samples per second and CPU time spent
+ * per sample. /dev/mpu6050 delivers at most one sample per poll_ms, so
+ * its rate is the acquisition rate and its CPU cost is the interesting
+ * number.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libmpu6050.h"
+
+static double clock_s(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void print_values(const struct mpu6050_values *v)
+{
+	printf("%llu.%09llu accel %6d %6d %6d gyro %6d %6d %6d temp %3d",
+	       (unsigned long long)(v->timestamp / 1000000000),
+	       (unsigned long long)(v->timestamp % 1000000000),
+	       v->accel[0], v->accel[1], v->accel[2],
+	       v->gyro[0], v->gyro[1], v->gyro[2], v->temperature);
+	if (v->has_mag)
+		printf(" mag %6d %6d %6d", v->mag[0], v->mag[1], v->mag[2]);
+	printf("\n");
+}
+
+static int bench_method(enum mpu6050_method method, double seconds)
+{
+	struct mpu6050 *dev = mpu6050_open(method);
+	struct mpu6050_values v;
+	double start, cpu_start, elapsed, cpu;
+	unsigned long n = 0;
+
+	if (dev == NULL) {
+		printf("%-14s not available: %m\n", mpu6050_method_name(method));
+		return 0;
+	}
+
+	start = clock_s(CLOCK_MONOTONIC);
+	cpu_start = clock_s(CLOCK_PROCESS_CPUTIME_ID);
+	do {
+		if (mpu6050_read(dev, &v)) {
+			printf("%-14s read error: %m\n",
+			       mpu6050_method_name(method));
+			mpu6050_close(dev);
+			return -1;
+		}
+		n++;
+	} while (clock_s(CLOCK_MONOTONIC) - start < seconds);
+	elapsed = clock_s(CLOCK_MONOTONIC) - start;
+	cpu = clock_s(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+
+	printf("%-14s %12.0f %14.2f\n", mpu6050_method_name(method),
+	       n / elapsed, cpu * 1e6 / n);
+	mpu6050_close(dev);
+	return 0;
+}
+
+static int parse_method(const char *name, enum mpu6050_method *method)
+{
+	enum mpu6050_method m;
+
+	for (m = MPU6050_AUTO; m <= MPU6050_SYSFS_REOPEN; m++)
+		if (!strcmp(name, mpu6050_method_name(m))) {
+			*method = m;
+			return 0;
+		}
+	return -1;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-m auto|dev|sysfs|sysfs-reopen] [-n samples]\n"
+		"       %s -b seconds\n", prog, prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	enum mpu6050_method method = MPU6050_AUTO;
+	struct mpu6050_values v;
+	struct mpu6050 *dev;
+	double bench = 0;
+	long i, count = 1;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "m:n:b:")) != -1) {
+		switch (opt) {
+		case 'm':
+			if (parse_method(optarg, &method))
+				usage(argv[0]);
+			break;
+		case 'n':
+			count = atol(optarg);
+			break;
+		case 'b':
+			bench = atof(optarg);
+			if (bench <= 0)
+				usage(argv[0]);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (bench) {
+		printf("%-14s %12s %14s\n", "method", "samples/s", "CPU us/sample");
+		for (method = MPU6050_DEV; method <= MPU6050_SYSFS_REOPEN; method++)
+			ret |= bench_method(method, bench);
+		return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	dev = mpu6050_open(method);
+	if (dev == NULL) {
+		fprintf(stderr, "can't open mpu6050 (%s): %m\n",
+			mpu6050_method_name(method));
+		return EXIT_FAILURE;
+	}
+	fprintf(stderr, "using %s\n", mpu6050_method_name(mpu6050_method(dev)));
+
+	for (i = 0; count <= 0 || i < count; i++) {
+		if (mpu6050_read(dev, &v)) {
+			fprintf(stderr, "read error: %m\n");
+			ret = -1;
+			break;
+		}
+		print_values(&v);
+	}
+
+	mpu6050_close(dev);
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+/*
+ * Stress test and throughput benchmark for the mpu6050 sample ring.
+ *
+ * Runs the ring code from mpu6050-ring.h in userspace: one producer thread
+ * pushes samples at a fixed rate while 1..16 reader threads follow it
+ * with their own cursors. Every sample carries its sequence number, so
+ * torn or out-of-order reads are detected.
+ *
+ * "kept" is the share of pushed samples each reader got on average. An
+ * unthrottled producer (rate 0) laps every reader, then read/s measures
+ * overrun handling rather than reader throughput.
+ *
+ * usage: ringstress [seconds per run] [max readers] [pushes/s, 0 - no limit]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#define READ_ONCE(x)		__atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define WRITE_ONCE(x, v)	__atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#define smp_load_acquire(p)	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define smp_wmb()		__atomic_thread_fence(__ATOMIC_RELEASE)
+#define smp_rmb()		__atomic_thread_fence(__ATOMIC_ACQUIRE)
+
+#include "mpu6050-ring.h"
+
+static struct mpu6050_ring ring;
+static volatile int stop;
+static long rate = 100000;
+
+struct reader_stat {
+	pthread_t thread;
+	unsigned long samples;
+	unsigned long overruns;
+	unsigned long errors;
+};
+
+static void timespec_add_ns(struct timespec *ts, long ns)
+{
+	ts->tv_nsec += ns;
+	while (ts->tv_nsec >= 1000000000) {
+		ts->tv_nsec -= 1000000000;
+		ts->tv_sec++;
+	}
+}
+
+/*
+ * Pushes 'burst' samples every 'period' ns, one per tick below 1000/s and
+ * rate/1000 per millisecond above, so sleep granularity does not matter.
+ */
+static void *producer(void *arg)
+{
+	unsigned long *pushed = arg;
+	struct mpu6050_sample sample;
+	unsigned int seq = 0;
+	long burst = 1, period = 0, n;
+	struct timespec next;
+	int i;
+
+	if (rate >= 1000) {
+		burst = rate / 1000;
+		period = 1000000;
+	} else if (rate > 0) {
+		period = 1000000000 / rate;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	memset(&sample, 0, sizeof(sample));
+	while (!stop) {
+		for (n = 0; n < burst; n++) {
+			sample.timestamp = seq;
+			for (i = 0; i < 3; i++) {
+				sample.accel[i] = (__s16)(seq + i);
+				sample.gyro[i] = (__s16)~(seq + i);
+			}
+			mpu6050_ring_push(&ring, &sample);
+			seq++;
+		}
+		if (period) {
+			timespec_add_ns(&next, period);
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+	}
+	*pushed = seq;
+	return NULL;
+}
+
+static void *reader(void *arg)
+{
+	struct reader_stat *st = arg;
+	struct mpu6050_sample sample;
+	unsigned int cursor = smp_load_acquire(&ring.head);
+	unsigned int expect = cursor;
+	int i, ret;
+
+	while (!stop) {
+		ret = mpu6050_ring_read(&ring, &cursor, &sample);
+		if (ret == -EAGAIN)
+			continue;
+		if (ret == -EOVERFLOW) {
+			st->overruns++;
+			expect = cursor;
+			continue;
+		}
+		if ((unsigned int)sample.timestamp != expect)
+			st->errors++;
+		for (i = 0; i < 3; i++)
+			if (sample.accel[i] != (__s16)(expect + i) ||
+			    sample.gyro[i] != (__s16)~(expect + i))
+				st->errors++;
+		expect++;
+		st->samples++;
+	}
+	return NULL;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int run(int nreaders, double seconds)
+{
+	struct reader_stat st[nreaders];
+	unsigned long pushed = 0, samples = 0, overruns = 0, errors = 0;
+	pthread_t prod;
+	struct timespec delay = {
+		.tv_sec = (time_t)seconds,
+		.tv_nsec = (long)((seconds - (time_t)seconds) * 1e9),
+	};
+	double start, elapsed;
+	int i;
+
+	mpu6050_ring_init(&ring);
+	memset(st, 0, sizeof(st));
+	stop = 0;
+
+	for (i = 0; i < nreaders; i++)
+		pthread_create(&st[i].thread, NULL, reader, &st[i]);
+	start = now();
+	pthread_create(&prod, NULL, producer, &pushed);
+	nanosleep(&delay, NULL);
+	stop = 1;
+	pthread_join(prod, NULL);
+	for (i = 0; i < nreaders; i++) {
+		pthread_join(st[i].thread, NULL);
+		samples += st[i].samples;
+		overruns += st[i].overruns;
+		errors += st[i].errors;
+	}
+	elapsed = now() - start;
+
+	printf("%7d %14.0f %14.0f %7.1f%% %10lu %8lu\n", nreaders,
+	       pushed / elapsed, samples / elapsed,
+	       pushed ? 100.0 * samples / nreaders / pushed : 0.0,
+	       overruns, errors);
+	return errors != 0;
+}
+
+int main(int argc, char *argv[])
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+	int max = argc > 2 ? atoi(argv[2]) : 16;
+	int n, failed = 0;
+
+	if (argc > 3)
+		rate = atol(argv[3]);
+	if (seconds <= 0 || max <= 0 || rate < 0) {
+		fprintf(stderr, "usage: %s [seconds per run] [max readers] "
+			"[pushes/s, 0 - no limit]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	printf("ring: %d slots of %zu bytes\n", MPU6050_RING_SIZE,
+	       sizeof(struct mpu6050_ring_slot));
+	printf("producer: %ld pushes/s%s\n", rate, rate ? "" : " (no limit)");
+	printf("%7s %14s %14s %8s %10s %8s\n", "readers", "pushed/s",
+	       "read/s (all)", "kept", "overruns", "errors");
+	for (n = 1; n <= max; n *= 2)
+		failed |= run(n, seconds);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}